@@ -22,41 +22,75 @@
  * THE SOFTWARE.
  */
 
-#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+#include "parse.hpp"
 #include "utils/strings.hpp"
 
 namespace ast {
 	using std::string;
 	using std::unordered_map;
 	using std::vector;
-	using std::shared_ptr;
 
+	/** Gets the arena AST nodes are currently allocated from; a null 
+	 *  arena means the process-wide default arena, which is freed on exit. */
+	inline parse::arena*& current_arena() {
+		static thread_local parse::arena* a = 0;
+		return a;
+	}
+
+	/** Gets the arena AST nodes are currently allocated from. */
+	inline parse::arena& nodes() {
+		static parse::arena global;
+		parse::arena* a = current_arena();
+		return a ? *a : global;
+	}
+
+	/** Allocates AST nodes made by make_ptr() from the given arena for the 
+	 *  lifetime of this object. The nodes are owned by the arena, and freed 
+	 *  all at once with it, so the arena must outlive any AST built in 
+	 *  this scope. */
+	class arena_scope {
+	public:
+		arena_scope(parse::arena& a) : prev(current_arena()) { current_arena() = &a; }
+		~arena_scope() { current_arena() = prev; }
+	private:
+		arena_scope(const arena_scope&);
+		arena_scope& operator= (const arena_scope&);
+
+		parse::arena* prev;	/**< arena to restore */
+	}; /* class arena_scope */
+
+	/** Makes an AST node in the current arena. */
 	template<typename T, typename... Args>
-	shared_ptr<T> make_ptr(Args... args) { return std::make_shared<T>(args...); }
+	T* make_ptr(Args&&... args) { return nodes().make<T>(std::forward<Args>(args)...); }
 
 	template<typename T, typename U>
-	shared_ptr<T> as_ptr(const shared_ptr<U>& r) { return std::static_pointer_cast<T>(r); }
+	T* as_ptr(U* r) { return static_cast<T*>(r); }
 
 	/** Represents a character range. */
 	class char_range {
 	public:
-		char_range(char from, char to) : from(from), to(to) {}
-		char_range(char c) : from(c), to(c) {}
+		char_range(char from, char to) 
+			: from((unsigned char)from), to((unsigned char)to) {}
+		char_range(char c) : from((unsigned char)c), to((unsigned char)c) {}
+		char_range(char32_t from, char32_t to) : from(from), to(to) {}
+		char_range(char32_t c) : from(c), to(c) {}
 		char_range(const char_range& o) : from(o.from), to(o.to) {}
 		char_range() : from('\0'), to('\0') {}
 
-		bool single() { return from == to; }
+		bool single() const { return from == to; }
 
-		char from;	/**< The first character in the range */
-		char to;	/**< The last character in the range. If this is the same 
-					 *   as the first character, represents a single character 
-					 */
+		char32_t from;	/**< The first character in the range (a byte value, 
+		              	 *   or a codepoint in a Unicode class) */
+		char32_t to;	/**< The last character in the range. If this is the 
+		            	 *   same as the first character, represents a single 
+		            	 *   character 
+		            	 */
 	}; /* class char_range */
-	typedef shared_ptr<char_range> char_range_ptr;
+	typedef char_range* char_range_ptr;
 
 	class char_matcher;
 	class str_matcher;
@@ -73,6 +107,7 @@ namespace ast {
 	class look_matcher;
 	class not_matcher;
 	class capt_matcher;
+	class cut_matcher;
 
 	/** Type of AST node. */
 	enum matcher_type {
@@ -90,7 +125,8 @@ namespace ast {
 		alt_type,
 		look_type,
 		not_type,
-		capt_type
+		capt_type,
+		cut_type
 	}; /* enum matcher_type */
 	
 	/** Abstract base class of all matcher visitors.
@@ -112,10 +148,12 @@ namespace ast {
 		virtual void visit(look_matcher&) = 0;
 		virtual void visit(not_matcher&) = 0;
 		virtual void visit(capt_matcher&) = 0;
+		virtual void visit(cut_matcher&) = 0;
 	}; /* class visitor */
 	
 	/** Abstract base class of all matchers.
-	 *  Implements visitor pattern. */
+	 *  Implements visitor pattern. Matchers are made by make_ptr(), and 
+	 *  owned by the arena they are allocated from. */
 	class matcher {
 	public:
 		/** Implements visitor pattern. */
@@ -123,7 +161,7 @@ namespace ast {
 		/** Gets type tag. */
 		virtual matcher_type type() = 0;
 	}; /* class matcher */
-	typedef shared_ptr<matcher> matcher_ptr;
+	typedef matcher* matcher_ptr;
 	
 	/** Matches a character literal. */
 	class char_matcher : public matcher {
@@ -136,7 +174,7 @@ namespace ast {
 		
 		char c; /**< char to match */
 	}; /* class char_matcher */
-	typedef shared_ptr<char_matcher> char_matcher_ptr;
+	typedef char_matcher* char_matcher_ptr;
 
 	/** Matches a string literal. */
 	class str_matcher : public matcher {
@@ -149,21 +187,30 @@ namespace ast {
 
 		string s; /**< string to match */
 	}; /* class str_matcher */
-	typedef shared_ptr<str_matcher> str_matcher_ptr;
+	typedef str_matcher* str_matcher_ptr;
 
 	/** Matches a character range. */
 	class range_matcher : public matcher {
 	public:
-		range_matcher() {}
+		range_matcher() : neg(false), utf8(false) {}
 
 		void accept(visitor* v) { v->visit(*this); }
 		matcher_type type() { return range_type; }
 
-		range_matcher& operator += (char_range r) { rs.push_back(r); return *this; }
+		/** Adds a range; one with a character past ASCII makes the class a 
+		 *  Unicode class */
+		range_matcher& operator += (char_range r) {
+			if ( r.to > 0x7f ) utf8 = true;
+			rs.push_back(r);
+			return *this;
+		}
 
 		vector<char_range> rs; /**< contained character ranges */
+		bool neg;              /**< matches characters *not* in the ranges */
+		bool utf8;             /**< matches a UTF-8 encoded codepoint, rather 
+		                        *   than a single character */
 	}; /* class range_matcher */
-	typedef shared_ptr<range_matcher> range_matcher_ptr;
+	typedef range_matcher* range_matcher_ptr;
 
 	/** Matches a grammar rule invocation. */
 	class rule_matcher : public matcher {
@@ -179,7 +226,7 @@ namespace ast {
 		string var;		/**< Variable to bind to the rule return. 
 						 *   Empty if unset. */
 	}; /* class rule_matcher */
-	typedef shared_ptr<rule_matcher> rule_matcher_ptr;
+	typedef rule_matcher* rule_matcher_ptr;
 
 	/** Matches any character. */
 	class any_matcher : public matcher {
@@ -189,7 +236,7 @@ namespace ast {
 		void accept(visitor* v) { v->visit(*this); }
 		matcher_type type() { return any_type; }
 	}; /* class any_matcher */
-	typedef shared_ptr<any_matcher> any_matcher_ptr;
+	typedef any_matcher* any_matcher_ptr;
 
 	/** Always matches without consuming a character. */
 	class empty_matcher : public matcher {
@@ -199,7 +246,7 @@ namespace ast {
 		void accept(visitor* v) { v->visit(*this); }
 		matcher_type type() { return empty_type; }
 	}; /* class empty_matcher */
-	typedef shared_ptr<empty_matcher> empty_matcher_ptr;
+	typedef empty_matcher* empty_matcher_ptr;
 
 	/** Semantic action; not actually a matcher. */
 	class action_matcher : public matcher {
@@ -212,46 +259,46 @@ namespace ast {
 
 		string a; /**< The string representing the action */
 	}; /* class action_matcher */
-	typedef shared_ptr<action_matcher> action_matcher_ptr;
+	typedef action_matcher* action_matcher_ptr;
 
 	/** An optional matcher */
 	class opt_matcher : public matcher {
 	public:
-		opt_matcher(shared_ptr<matcher> m) : m(m) {}
-		opt_matcher() {}
+		opt_matcher(matcher_ptr m) : m(m) {}
+		opt_matcher() : m(0) {}
 
 		void accept(visitor* v) { v->visit(*this); }
 		matcher_type type() { return opt_type; }
 
-		shared_ptr<matcher> m; /**< contained matcher */
+		matcher_ptr m; /**< contained matcher */
 	}; /* class opt_matcher */
-	typedef shared_ptr<opt_matcher> opt_matcher_ptr;
+	typedef opt_matcher* opt_matcher_ptr;
 
 	/** Matches any number of times */
 	class many_matcher : public matcher {
 	public:
-		many_matcher(shared_ptr<matcher> m) : m(m) {}
-		many_matcher() {}
+		many_matcher(matcher_ptr m) : m(m) {}
+		many_matcher() : m(0) {}
 
 		void accept(visitor* v) { v->visit(*this); }
 		matcher_type type() { return many_type; }
 
-		shared_ptr<matcher> m; /**< contained matcher */
+		matcher_ptr m; /**< contained matcher */
 	}; /* class many_matcher */
-	typedef shared_ptr<many_matcher> many_matcher_ptr;
+	typedef many_matcher* many_matcher_ptr;
 
 	/** Matches some non-zero number of times */
 	class some_matcher : public matcher {
 	public:
-		some_matcher(shared_ptr<matcher> m) : m(m) {}
-		some_matcher() {}
+		some_matcher(matcher_ptr m) : m(m) {}
+		some_matcher() : m(0) {}
 
 		void accept(visitor* v) { v->visit(*this); }
 		matcher_type type() { return some_type; }
 
-		shared_ptr<matcher> m; /**< contained matcher */
+		matcher_ptr m; /**< contained matcher */
 	}; /* class some_matcher */
-	typedef shared_ptr<some_matcher> some_matcher_ptr;
+	typedef some_matcher* some_matcher_ptr;
 
 	/** Sequence of matchers. */
 	class seq_matcher : public matcher {
@@ -261,11 +308,11 @@ namespace ast {
 		void accept(visitor* v) { v->visit(*this); }
 		matcher_type type() { return seq_type; }
 
-		seq_matcher& operator += (shared_ptr<matcher> m) { ms.push_back(m); return *this; }
+		seq_matcher& operator += (matcher_ptr m) { ms.push_back(m); return *this; }
 
-		vector<shared_ptr<matcher>> ms; /**< The matchers in the sequence */
+		vector<matcher_ptr> ms; /**< The matchers in the sequence */
 	}; /* class seq_matcher */
-	typedef shared_ptr<seq_matcher> seq_matcher_ptr;
+	typedef seq_matcher* seq_matcher_ptr;
 
 	/** Alternation matcher. */
 	class alt_matcher : public matcher {
@@ -275,50 +322,61 @@ namespace ast {
 		void accept(visitor* v) { v->visit(*this); }
 		matcher_type type() { return alt_type; }
 
-		alt_matcher& operator += (shared_ptr<matcher> m) { ms.push_back(m); return *this; }
+		alt_matcher& operator += (matcher_ptr m) { ms.push_back(m); return *this; }
 
-		vector<shared_ptr<matcher>> ms; /**< The alternate matchers */
+		vector<matcher_ptr> ms; /**< The alternate matchers */
 	}; /* class alt_matcher */
-	typedef shared_ptr<alt_matcher> alt_matcher_ptr;
+	typedef alt_matcher* alt_matcher_ptr;
 
 	/** Lookahead matcher. */
 	class look_matcher : public matcher {
 	public:
-		look_matcher(shared_ptr<matcher> m) : m(m) {}
-		look_matcher() {}
+		look_matcher(matcher_ptr m) : m(m) {}
+		look_matcher() : m(0) {}
 
 		void accept(visitor* v) { v->visit(*this); }
 		matcher_type type() { return look_type; }
 
-		shared_ptr<matcher> m; /**< The matcher to check on lookahead */
+		matcher_ptr m; /**< The matcher to check on lookahead */
 	}; /* class look_matcher */
-	typedef shared_ptr<look_matcher> look_matcher_ptr;
+	typedef look_matcher* look_matcher_ptr;
 
 	/** Negative lookahead matcher. */
 	class not_matcher : public matcher {
 	public:
-		not_matcher(shared_ptr<matcher> m) : m(m) {}
-		not_matcher() {}
+		not_matcher(matcher_ptr m) : m(m) {}
+		not_matcher() : m(0) {}
 
 		void accept(visitor* v) { v->visit(*this); }
 		matcher_type type() { return not_type; }
 
-		shared_ptr<matcher> m; /**< The matcher to check on lookahead */
+		matcher_ptr m; /**< The matcher to check on lookahead */
 	}; /* class not_matcher */
-	typedef shared_ptr<not_matcher> not_matcher_ptr;
+	typedef not_matcher* not_matcher_ptr;
 
 	/** String-capturing matcher. */
 	class capt_matcher : public matcher {
 	public:
-		capt_matcher(shared_ptr<matcher> m) : m(m) {}
-		capt_matcher() {}
+		capt_matcher(matcher_ptr m) : m(m) {}
+		capt_matcher() : m(0) {}
 
 		void accept(visitor* v) { v->visit(*this); }
 		matcher_type type() { return capt_type; }
 
-		shared_ptr<matcher> m; /**< Captured matcher */
+		matcher_ptr m; /**< Captured matcher */
 	}; /* class capt_matcher */
-	typedef shared_ptr<capt_matcher> capt_matcher_ptr;
+	typedef capt_matcher* capt_matcher_ptr;
+
+	/** Cut point; always matches without consuming a character, and 
+	 *  discards all parser state before the current position. */
+	class cut_matcher : public matcher {
+	public:
+		cut_matcher() {}
+
+		void accept(visitor* v) { v->visit(*this); }
+		matcher_type type() { return cut_type; }
+	}; /* class cut_matcher */
+	typedef cut_matcher* cut_matcher_ptr;
 
 	/** Empty visitor class; provides a default implementation of each of the 
 	 *  methods. */
@@ -339,43 +397,55 @@ namespace ast {
 		void visit(look_matcher& m) {}
 		void visit(not_matcher& m) {}
 		void visit(capt_matcher& m) {}
+		void visit(cut_matcher& m) {}
 	}; /* class default_visitor */
 
 	/** Represents a grammar rule.
 	 *  Pairs a name and optional type with a matching rule. The contained rule 
-	 *  will be deleted on destruction. */
+	 *  is owned by the arena it was allocated from. */
 	class grammar_rule {
 	public:
-		grammar_rule(string name) : name(name), type("") {}
-		grammar_rule(string name, shared_ptr<matcher> m) : name(name), type(""), m(m) {}
-		grammar_rule(string name, string type, shared_ptr<matcher> m)
+		grammar_rule(string name) : name(name), type(""), m(0) {}
+		grammar_rule(string name, matcher_ptr m) : name(name), type(""), m(m) {}
+		grammar_rule(string name, string type, matcher_ptr m)
 			: name(name), type(type), m(m) {}
-		grammar_rule() {}
+		grammar_rule() : m(0) {}
+		
+		/** Checks if the rule has the given annotation (e.g. "memo" for 
+		 *  `%memo`). */
+		bool annotated(const string& a) const {
+			for (auto it = annotations.begin(); it != annotations.end(); ++it) {
+				if ( *it == a ) return true;
+			}
+			return false;
+		}
 		
 		string name;	/**< Name of the grammar rule */
 		string type;	/**< Type of the grammar rule's return (empty for none) */
-		shared_ptr<matcher> m;	/**< Grammar matching rule */
+		matcher_ptr m;	/**< Grammar matching rule */
+		vector<string> annotations;	/**< Rule annotations, without leading '%' */
 	}; /* class grammar_rule */
-	typedef shared_ptr<grammar_rule> grammar_rule_ptr;
+	typedef grammar_rule* grammar_rule_ptr;
 
 	/** Represents a Leg grammar. 
-	 *  Deletes the contained grammar rules on destruction. */
+	 *  The contained grammar rules are owned by the arena they were 
+	 *  allocated from. */
 	class grammar {
 	public:
 		grammar() {}
 
-		grammar& operator += (shared_ptr<grammar_rule> r) {
+		grammar& operator += (grammar_rule_ptr r) {
 			rs.push_back(r);
 			names.insert(std::make_pair(r->name, r));
 			return *this;
 		}
 
-		vector<shared_ptr<grammar_rule>> rs;	/**< list of grammar rules */
-		unordered_map<string, shared_ptr<grammar_rule>> names;
+		vector<grammar_rule_ptr> rs;	/**< list of grammar rules */
+		unordered_map<string, grammar_rule_ptr> names;
 										/**< lookup table of grammar rules by name */
 		string pre, post;				/**< pre and post-actions */
 	}; /* class grammar */
-	typedef shared_ptr<grammar> grammar_ptr;
+	typedef grammar* grammar_ptr;
 	
 } /* namespace ast */
 
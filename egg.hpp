@@ -26,7 +26,7 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  * THE SOFTWARE.
  */
-
+ 
 #include <string>
 
 #include "ast.hpp"
@@ -39,46 +39,64 @@
 
 namespace egg {
 
-	parse::result<ast::grammar_ptr > grammar(parse::state&);
-	parse::result<std::string > out_action(parse::state&);
-	parse::result<ast::grammar_rule_ptr > rule(parse::state&);
-	parse::result<std::string > identifier(parse::state&);
-	parse::result<std::string > type_id(parse::state&);
-	parse::result<ast::alt_matcher_ptr > choice(parse::state&);
-	parse::result<ast::seq_matcher_ptr > sequence(parse::state&);
-	parse::result<ast::matcher_ptr > expression(parse::state&);
-	parse::result<ast::matcher_ptr > primary(parse::state&);
-	parse::result<ast::action_matcher_ptr > action(parse::state&);
-	parse::result<ast::char_matcher_ptr > char_literal(parse::state&);
-	parse::result<ast::str_matcher_ptr > str_literal(parse::state&);
-	parse::result<ast::range_matcher_ptr > char_class(parse::state&);
-	parse::result<ast::char_range > characters(parse::state&);
-	parse::result<char > character(parse::state&);
-	parse::result<> OUT_BEGIN(parse::state&);
-	parse::result<> OUT_END(parse::state&);
-	parse::result<> BIND(parse::state&);
-	parse::result<> EQUAL(parse::state&);
-	parse::result<> PIPE(parse::state&);
-	parse::result<> AND(parse::state&);
-	parse::result<> NOT(parse::state&);
-	parse::result<> OPT(parse::state&);
-	parse::result<> STAR(parse::state&);
-	parse::result<> PLUS(parse::state&);
-	parse::result<> OPEN(parse::state&);
-	parse::result<> CLOSE(parse::state&);
-	parse::result<> ANY(parse::state&);
-	parse::result<> EMPTY(parse::state&);
-	parse::result<> BEGIN(parse::state&);
-	parse::result<> END(parse::state&);
-	parse::result<> _(parse::state&);
-	parse::result<> space(parse::state&);
-	parse::result<> comment(parse::state&);
-	parse::result<> end_of_line(parse::state&);
-	parse::result<> end_of_file(parse::state&);
-
-	parse::result<ast::grammar_ptr > grammar(parse::state& ps) {
-		parse::ind psStart = ps.pos;
-		ast::grammar_ptr  psVal;
+	typedef parse::state psState;
+
+	parse::result<ast::grammar_ptr > grammar(psState&);
+	parse::result<std::string > out_action(psState&);
+	parse::result<ast::grammar_rule_ptr > rule(psState&);
+	parse::result<std::string > annotation(psState&);
+	parse::result<std::string > identifier(psState&);
+	parse::result<std::string > type_id(psState&);
+	parse::result<ast::alt_matcher_ptr > choice(psState&);
+	parse::result<ast::seq_matcher_ptr > sequence(psState&);
+	parse::result<ast::matcher_ptr > expression(psState&);
+	parse::result<ast::matcher_ptr > primary(psState&);
+	parse::result<ast::action_matcher_ptr > action(psState&);
+	parse::result<ast::matcher_ptr > char_literal(psState&);
+	parse::result<ast::str_matcher_ptr > str_literal(psState&);
+	parse::result<ast::range_matcher_ptr > char_class(psState&);
+	parse::result<ast::char_range > characters(psState&);
+	parse::result<> unicode_escape(psState&);
+	parse::result<char32_t > character(psState&);
+	parse::result<> hex(psState&);
+	parse::result<> OUT_BEGIN(psState&);
+	parse::result<> OUT_END(psState&);
+	parse::result<> BIND(psState&);
+	parse::result<> EQUAL(psState&);
+	parse::result<> PIPE(psState&);
+	parse::result<> AND(psState&);
+	parse::result<> NOT(psState&);
+	parse::result<> OPT(psState&);
+	parse::result<> STAR(psState&);
+	parse::result<> PLUS(psState&);
+	parse::result<> OPEN(psState&);
+	parse::result<> CLOSE(psState&);
+	parse::result<> ANY(psState&);
+	parse::result<> EMPTY(psState&);
+	parse::result<> CUT(psState&);
+	parse::result<> BEGIN(psState&);
+	parse::result<> END(psState&);
+	parse::result<> _(psState&);
+	parse::result<> space(psState&);
+	parse::result<> comment(psState&);
+	parse::result<> end_of_line(psState&);
+	parse::result<> end_of_file(psState&);
+
+	constexpr parse::char_set psSet0 = {{ 0x0ull, 0x7fffffe87fffffeull, 0x0ull, 0x0ull }};
+	constexpr parse::char_set psSet1 = {{ 0x3ff000000000000ull, 0x7fffffe87fffffeull, 0x0ull, 0x0ull }};
+	constexpr parse::char_set psSet2 = {{ 0x0ull, 0x20000000200000ull, 0x0ull, 0x0ull }};
+	constexpr parse::char_set psSet3 = {{ 0x8400000000ull, 0x14400010000000ull, 0x0ull, 0x0ull }};
+	constexpr parse::char_set psSet4 = {{ 0x0ull, 0x0ull, 0x0ull, 0x0ull }};
+	constexpr parse::char_set psSet5 = {{ 0x8400000000ull, 0x10000000ull, 0x0ull, 0x0ull }};
+	constexpr parse::char_set psSet6 = {{ 0x3ff000000000000ull, 0x7e0000007eull, 0x0ull, 0x0ull }};
+	constexpr parse::char_set psSet7 = {{ 0x100000200ull, 0x0ull, 0x0ull, 0x0ull }};
+	constexpr parse::char_set psSet8 = {{ 0x2400ull, 0x0ull, 0x0ull, 0x0ull }};
+	constexpr parse::code_range psRanges0[] = { { 0x80, 0x10ffff } };
+	constexpr parse::code_set psCodes0 = { psRanges0, 1, "[\\u0080-\\U0010ffff]" };
+
+	parse::result<ast::grammar_ptr > grammar(psState& ps) {
+		parse::ind psStart = ps.pos;
+		ast::grammar_ptr  psVal{};
 
 		ast::grammar_rule_ptr  r;
 		std::string  s;
@@ -110,81 +128,116 @@ namespace egg {
 				if ( out_action(ps)(s)
 					&& [&]() { psVal->post = s;  return true; }() ) { return true; }
 				else { ps.pos = psStart; return false; } }(); return true; }()
-				&& end_of_file(ps) ) { return true; }
-			else { ps.pos = psStart; return false; } }() ) { return parse::match(psVal); }
+				&& [&]() {
+				parse::ind psStart = ps.pos;
+				ps.mute();
+				if ( parse::any(ps) ) { ps.pos = psStart; ps.unmute(); return false; }
+				else { ps.pos = psStart; ps.unmute(); return true; } }() ) { return true; }
+			else { ps.pos = psStart; return false; } }() ) { return parse::match(std::move(psVal)); }
 		else { return parse::fail<ast::grammar_ptr >(); }
 
 	}
 
-	parse::result<std::string > out_action(parse::state& ps) {
+	parse::result<std::string > out_action(psState& ps) {
 		parse::ind psStart = ps.pos;
-		std::string  psVal;
+		std::string  psVal{};
 
-		std::string psCapture;
+		parse::span psCapture;
 		parse::ind psCatch;
 		parse::ind psCatchLen;
 
 		if ( [&]() { 
 			parse::ind psStart = ps.pos;
-			if ( OUT_BEGIN(ps)
+			if ( parse::literal(ps, "{%", 2)
 				&& [&]() {
 				psCatch = ps.pos;
 				if ( [&]() { while ( [&]() { 
 						parse::ind psStart = ps.pos;
 						if ( [&]() {
 							parse::ind psStart = ps.pos;
-							if ( OUT_END(ps) ) { ps.pos = psStart; return false; }
-							else { ps.pos = psStart; return true; } }()
+							ps.mute();
+							if ( parse::literal(ps, "%}", 2) ) { ps.pos = psStart; ps.unmute(); return false; }
+							else { ps.pos = psStart; ps.unmute(); return true; } }()
 							&& parse::any(ps) ) { return true; }
 						else { ps.pos = psStart; return false; } }() )
 					;
 				return true; }() ) {
 					psCatchLen = ps.pos - psCatch;
-					psCapture = ps.string(psCatch, psCatchLen);
 					return true;
 				} else {
 					psCatchLen = 0;
-					psCapture = std::string("");
 					return false;
 				} }()
-				&& OUT_END(ps)
+				&& parse::literal(ps, "%}", 2)
 				&& _(ps)
-				&& [&]() { psVal = psCapture;  return true; }() ) { return true; }
-			else { ps.pos = psStart; return false; } }() ) { return parse::match(psVal); }
+				&& [&]() { psCapture = ps.view(psCatch, psCatchLen); psVal = psCapture;  return true; }() ) { return true; }
+			else { ps.pos = psStart; return false; } }() ) { return parse::match(std::move(psVal)); }
 		else { return parse::fail<std::string >(); }
 
 	}
 
-	parse::result<ast::grammar_rule_ptr > rule(parse::state& ps) {
+	parse::result<ast::grammar_rule_ptr > rule(psState& ps) {
 		parse::ind psStart = ps.pos;
-		ast::grammar_rule_ptr  psVal;
+		ast::grammar_rule_ptr  psVal{};
 
 		ast::alt_matcher_ptr  m;
 		std::string  s;
 
 		if ( [&]() { 
 			parse::ind psStart = ps.pos;
-			if ( identifier(ps)(s)
-				&& [&]() { psVal = ast::make_ptr<ast::grammar_rule>(s);  return true; }()
+			if ( [&]() { psVal = ast::make_ptr<ast::grammar_rule>();  return true; }()
+				&& [&]() { while ( [&]() { 
+					parse::ind psStart = ps.pos;
+					if ( annotation(ps)(s)
+						&& [&]() { psVal->annotations.push_back(s);  return true; }() ) { return true; }
+					else { ps.pos = psStart; return false; } }() )
+				;
+			return true; }()
+				&& identifier(ps)(s)
+				&& [&]() { psVal->name = s;  return true; }()
 				&& [&]() { [&]() { 
 				parse::ind psStart = ps.pos;
-				if ( BIND(ps)
+				if ( [&]() { 
+					parse::ind psStart = ps.pos;
+					if ( parse::matches<':'>(ps)
+						&& _(ps) ) { return true; }
+					else { ps.pos = psStart; return false; } }()
 					&& type_id(ps)(s)
 					&& [&]() { psVal->type = s;  return true; }() ) { return true; }
 				else { ps.pos = psStart; return false; } }(); return true; }()
-				&& EQUAL(ps)
+				&& [&]() { 
+				parse::ind psStart = ps.pos;
+				if ( parse::matches<'='>(ps)
+					&& _(ps) ) { return true; }
+				else { ps.pos = psStart; return false; } }()
 				&& choice(ps)(m)
 				&& [&]() { psVal->m = m;  return true; }() ) { return true; }
-			else { ps.pos = psStart; return false; } }() ) { return parse::match(psVal); }
+			else { ps.pos = psStart; return false; } }() ) { return parse::match(std::move(psVal)); }
 		else { return parse::fail<ast::grammar_rule_ptr >(); }
 
 	}
 
-	parse::result<std::string > identifier(parse::state& ps) {
+	parse::result<std::string > annotation(psState& ps) {
 		parse::ind psStart = ps.pos;
-		std::string  psVal;
+		std::string  psVal{};
 
-		std::string psCapture;
+		std::string  s;
+
+		if ( [&]() { 
+			parse::ind psStart = ps.pos;
+			if ( parse::matches<'%'>(ps)
+				&& identifier(ps)(s)
+				&& [&]() { psVal = s;  return true; }() ) { return true; }
+			else { ps.pos = psStart; return false; } }() ) { return parse::match(std::move(psVal)); }
+		else { return parse::fail<std::string >(); }
+
+	}
+
+	parse::result<std::string > identifier(psState& ps) {
+		parse::ind psStart = ps.pos;
+		std::string  psVal{};
+
+		parse::span psCapture;
 		parse::ind psCatch;
 		parse::ind psCatchLen;
 
@@ -194,36 +247,27 @@ namespace egg {
 				psCatch = ps.pos;
 				if ( [&]() { 
 					parse::ind psStart = ps.pos;
-					if ( ( parse::in_range<'A','Z'>(ps)
-						|| parse::in_range<'a','z'>(ps)
-						|| parse::matches<'_'>(ps) )
-						&& [&]() { while ( ( parse::in_range<'A','Z'>(ps)
-							|| parse::in_range<'a','z'>(ps)
-							|| parse::matches<'_'>(ps)
-							|| parse::in_range<'0','9'>(ps) ) )
-						;
-					return true; }() ) { return true; }
+					if ( parse::in_set<psSet0>(ps)
+						&& parse::many_in_set<psSet1>(ps) ) { return true; }
 					else { ps.pos = psStart; return false; } }() ) {
 					psCatchLen = ps.pos - psCatch;
-					psCapture = ps.string(psCatch, psCatchLen);
 					return true;
 				} else {
 					psCatchLen = 0;
-					psCapture = std::string("");
 					return false;
 				} }()
 				&& _(ps)
-				&& [&]() { psVal = psCapture;  return true; }() ) { return true; }
-			else { ps.pos = psStart; return false; } }() ) { return parse::match(psVal); }
+				&& [&]() { psCapture = ps.view(psCatch, psCatchLen); psVal = psCapture;  return true; }() ) { return true; }
+			else { ps.pos = psStart; return false; } }() ) { return parse::match(std::move(psVal)); }
 		else { return parse::fail<std::string >(); }
 
 	}
 
-	parse::result<std::string > type_id(parse::state& ps) {
+	parse::result<std::string > type_id(psState& ps) {
 		parse::ind psStart = ps.pos;
-		std::string  psVal;
+		std::string  psVal{};
 
-		std::string psCapture;
+		parse::span psCapture;
 		parse::ind psCatch;
 		parse::ind psCatchLen;
 
@@ -236,13 +280,7 @@ namespace egg {
 					if ( identifier(ps)
 						&& [&]() { while ( [&]() { 
 							parse::ind psStart = ps.pos;
-							if ( [&ps]() {
-								parse::ind psStart = ps.pos;
-
-								if ( ':' == ps[ps.pos++]
-								&& ':' == ps[ps.pos++] ) { return true; }
-								else { ps.pos= psStart; return false; }
-								}()
+							if ( parse::literal(ps, "::", 2)
 								&& _(ps)
 								&& type_id(ps) ) { return true; }
 							else { ps.pos = psStart; return false; } }() )
@@ -266,22 +304,20 @@ namespace egg {
 						else { ps.pos = psStart; return false; } }(); return true; }() ) { return true; }
 					else { ps.pos = psStart; return false; } }() ) {
 					psCatchLen = ps.pos - psCatch;
-					psCapture = ps.string(psCatch, psCatchLen);
 					return true;
 				} else {
 					psCatchLen = 0;
-					psCapture = std::string("");
 					return false;
 				} }()
-				&& [&]() { psVal = psCapture;  return true; }() ) { return true; }
-			else { ps.pos = psStart; return false; } }() ) { return parse::match(psVal); }
+				&& [&]() { psCapture = ps.view(psCatch, psCatchLen); psVal = psCapture;  return true; }() ) { return true; }
+			else { ps.pos = psStart; return false; } }() ) { return parse::match(std::move(psVal)); }
 		else { return parse::fail<std::string >(); }
 
 	}
 
-	parse::result<ast::alt_matcher_ptr > choice(parse::state& ps) {
+	parse::result<ast::alt_matcher_ptr > choice(psState& ps) {
 		parse::ind psStart = ps.pos;
-		ast::alt_matcher_ptr  psVal;
+		ast::alt_matcher_ptr  psVal{};
 
 		ast::seq_matcher_ptr  m;
 
@@ -291,20 +327,24 @@ namespace egg {
 				&& [&]() { psVal = ast::make_ptr<ast::alt_matcher>(); *psVal += m;  return true; }()
 				&& [&]() { while ( [&]() { 
 					parse::ind psStart = ps.pos;
-					if ( PIPE(ps)
+					if ( [&]() { 
+						parse::ind psStart = ps.pos;
+						if ( parse::matches<'|'>(ps)
+							&& _(ps) ) { return true; }
+						else { ps.pos = psStart; return false; } }()
 						&& sequence(ps)(m)
 						&& [&]() { *psVal += m;  return true; }() ) { return true; }
 					else { ps.pos = psStart; return false; } }() )
 				;
 			return true; }() ) { return true; }
-			else { ps.pos = psStart; return false; } }() ) { return parse::match(psVal); }
+			else { ps.pos = psStart; return false; } }() ) { return parse::match(std::move(psVal)); }
 		else { return parse::fail<ast::alt_matcher_ptr >(); }
 
 	}
 
-	parse::result<ast::seq_matcher_ptr > sequence(parse::state& ps) {
+	parse::result<ast::seq_matcher_ptr > sequence(psState& ps) {
 		parse::ind psStart = ps.pos;
-		ast::seq_matcher_ptr  psVal;
+		ast::seq_matcher_ptr  psVal{};
 
 		ast::action_matcher_ptr  a;
 		ast::matcher_ptr  e;
@@ -312,158 +352,295 @@ namespace egg {
 		if ( [&]() { 
 			parse::ind psStart = ps.pos;
 			if ( [&]() { psVal = ast::make_ptr<ast::seq_matcher>();  return true; }()
-				&& [&]() { if ( ( [&]() { 
-						parse::ind psStart = ps.pos;
-						if ( expression(ps)(e)
-							&& [&]() { *psVal += e;  return true; }() ) { return true; }
-						else { ps.pos = psStart; return false; } }()
-					|| [&]() { 
-						parse::ind psStart = ps.pos;
-						if ( action(ps)(a)
-							&& [&]() { *psVal += a;  return true; }() ) { return true; }
-						else { ps.pos = psStart; return false; } }() ) ) {
-				while ( ( [&]() { 
-						parse::ind psStart = ps.pos;
-						if ( expression(ps)(e)
-							&& [&]() { *psVal += e;  return true; }() ) { return true; }
-						else { ps.pos = psStart; return false; } }()
-					|| [&]() { 
-						parse::ind psStart = ps.pos;
-						if ( action(ps)(a)
-							&& [&]() { *psVal += a;  return true; }() ) { return true; }
-						else { ps.pos = psStart; return false; } }() ) )
+				&& [&]() { if ( [&]() -> bool {
+					switch ( ps[ps.pos] ) {
+					case '!': case '\"': case '&': case '\'': case '(': case '.': case ';': case '<': 
+					case 'A': case 'B': case 'C': case 'D': case 'E': case 'F': case 'G': case 'H': 
+					case 'I': case 'J': case 'K': case 'L': case 'M': case 'N': case 'O': case 'P': 
+					case 'Q': case 'R': case 'S': case 'T': case 'U': case 'V': case 'W': case 'X': 
+					case 'Y': case 'Z': case '[': case '^': case '_': case 'a': case 'b': case 'c': 
+					case 'd': case 'e': case 'f': case 'g': case 'h': case 'i': case 'j': case 'k': 
+					case 'l': case 'm': case 'n': case 'o': case 'p': case 'q': case 'r': case 's': 
+					case 't': case 'u': case 'v': case 'w': case 'x': case 'y': case 'z': 
+						return [&]() { 
+							parse::ind psStart = ps.pos;
+							if ( expression(ps)(e)
+								&& [&]() { *psVal += e;  return true; }() ) { return true; }
+							else { ps.pos = psStart; return false; } }();
+					case '{': 
+						return [&]() { 
+							parse::ind psStart = ps.pos;
+							if ( action(ps)(a)
+								&& [&]() { *psVal += a;  return true; }() ) { return true; }
+							else { ps.pos = psStart; return false; } }();
+					default:
+						return ps.expect(parse::expectation::named("[!\"&-(.;<A-[^_a-{]"));
+					} }() ) {
+				while ( [&]() -> bool {
+					switch ( ps[ps.pos] ) {
+					case '!': case '\"': case '&': case '\'': case '(': case '.': case ';': case '<': 
+					case 'A': case 'B': case 'C': case 'D': case 'E': case 'F': case 'G': case 'H': 
+					case 'I': case 'J': case 'K': case 'L': case 'M': case 'N': case 'O': case 'P': 
+					case 'Q': case 'R': case 'S': case 'T': case 'U': case 'V': case 'W': case 'X': 
+					case 'Y': case 'Z': case '[': case '^': case '_': case 'a': case 'b': case 'c': 
+					case 'd': case 'e': case 'f': case 'g': case 'h': case 'i': case 'j': case 'k': 
+					case 'l': case 'm': case 'n': case 'o': case 'p': case 'q': case 'r': case 's': 
+					case 't': case 'u': case 'v': case 'w': case 'x': case 'y': case 'z': 
+						return [&]() { 
+							parse::ind psStart = ps.pos;
+							if ( expression(ps)(e)
+								&& [&]() { *psVal += e;  return true; }() ) { return true; }
+							else { ps.pos = psStart; return false; } }();
+					case '{': 
+						return [&]() { 
+							parse::ind psStart = ps.pos;
+							if ( action(ps)(a)
+								&& [&]() { *psVal += a;  return true; }() ) { return true; }
+							else { ps.pos = psStart; return false; } }();
+					default:
+						return ps.expect(parse::expectation::named("[!\"&-(.;<A-[^_a-{]"));
+					} }() )
 					;
 				return true;
 			} else { return false; } }() ) { return true; }
-			else { ps.pos = psStart; return false; } }() ) { return parse::match(psVal); }
+			else { ps.pos = psStart; return false; } }() ) { return parse::match(std::move(psVal)); }
 		else { return parse::fail<ast::seq_matcher_ptr >(); }
 
 	}
 
-	parse::result<ast::matcher_ptr > expression(parse::state& ps) {
+	parse::result<ast::matcher_ptr > expression(psState& ps) {
 		parse::ind psStart = ps.pos;
-		ast::matcher_ptr  psVal;
+		ast::matcher_ptr  psVal{};
 
 		ast::matcher_ptr  m;
 
-		if ( ( [&]() { 
-				parse::ind psStart = ps.pos;
-				if ( AND(ps)
-					&& primary(ps)(m)
-					&& [&]() { psVal = ast::make_ptr<ast::look_matcher>(m);  return true; }() ) { return true; }
-				else { ps.pos = psStart; return false; } }()
-			|| [&]() { 
-				parse::ind psStart = ps.pos;
-				if ( NOT(ps)
-					&& primary(ps)(m)
-					&& [&]() { psVal = ast::make_ptr<ast::not_matcher>(m);  return true; }() ) { return true; }
-				else { ps.pos = psStart; return false; } }()
-			|| [&]() { 
-				parse::ind psStart = ps.pos;
-				if ( primary(ps)(m)
-					&& [&]() { psVal = m;  return true; }()
-					&& [&]() { ( [&]() { 
+		if ( [&]() -> bool {
+			switch ( ps[ps.pos] ) {
+			case '&': 
+				return [&]() { 
+					parse::ind psStart = ps.pos;
+					if ( [&]() { 
 						parse::ind psStart = ps.pos;
-						if ( OPT(ps)
-							&& [&]() { psVal = ast::make_ptr<ast::opt_matcher>(m);  return true; }() ) { return true; }
+						if ( parse::matches<'&'>(ps)
+							&& _(ps) ) { return true; }
 						else { ps.pos = psStart; return false; } }()
-					|| [&]() { 
+						&& primary(ps)(m)
+						&& [&]() { psVal = ast::make_ptr<ast::look_matcher>(m);  return true; }() ) { return true; }
+					else { ps.pos = psStart; return false; } }();
+			case '!': 
+				return [&]() { 
+					parse::ind psStart = ps.pos;
+					if ( [&]() { 
 						parse::ind psStart = ps.pos;
-						if ( STAR(ps)
-							&& [&]() { psVal = ast::make_ptr<ast::many_matcher>(m);  return true; }() ) { return true; }
+						if ( parse::matches<'!'>(ps)
+							&& _(ps) ) { return true; }
 						else { ps.pos = psStart; return false; } }()
-					|| [&]() { 
-						parse::ind psStart = ps.pos;
-						if ( PLUS(ps)
-							&& [&]() { psVal = ast::make_ptr<ast::some_matcher>(m);  return true; }() ) { return true; }
-						else { ps.pos = psStart; return false; } }() ); return true; }() ) { return true; }
-				else { ps.pos = psStart; return false; } }() ) ) { return parse::match(psVal); }
+						&& primary(ps)(m)
+						&& [&]() { psVal = ast::make_ptr<ast::not_matcher>(m);  return true; }() ) { return true; }
+					else { ps.pos = psStart; return false; } }();
+			case '\"': case '\'': case '(': case '.': case ';': case '<': case 'A': case 'B': 
+			case 'C': case 'D': case 'E': case 'F': case 'G': case 'H': case 'I': case 'J': 
+			case 'K': case 'L': case 'M': case 'N': case 'O': case 'P': case 'Q': case 'R': 
+			case 'S': case 'T': case 'U': case 'V': case 'W': case 'X': case 'Y': case 'Z': 
+			case '[': case '^': case '_': case 'a': case 'b': case 'c': case 'd': case 'e': 
+			case 'f': case 'g': case 'h': case 'i': case 'j': case 'k': case 'l': case 'm': 
+			case 'n': case 'o': case 'p': case 'q': case 'r': case 's': case 't': case 'u': 
+			case 'v': case 'w': case 'x': case 'y': case 'z': 
+				return [&]() { 
+					parse::ind psStart = ps.pos;
+					if ( primary(ps)(m)
+						&& [&]() { psVal = m;  return true; }()
+						&& [&]() { [&]() -> bool {
+						switch ( ps[ps.pos] ) {
+						case '?': 
+							return [&]() { 
+								parse::ind psStart = ps.pos;
+								if ( [&]() { 
+									parse::ind psStart = ps.pos;
+									if ( parse::matches<'?'>(ps)
+										&& _(ps) ) { return true; }
+									else { ps.pos = psStart; return false; } }()
+									&& [&]() { psVal = ast::make_ptr<ast::opt_matcher>(m);  return true; }() ) { return true; }
+								else { ps.pos = psStart; return false; } }();
+						case '*': 
+							return [&]() { 
+								parse::ind psStart = ps.pos;
+								if ( [&]() { 
+									parse::ind psStart = ps.pos;
+									if ( parse::matches<'*'>(ps)
+										&& _(ps) ) { return true; }
+									else { ps.pos = psStart; return false; } }()
+									&& [&]() { psVal = ast::make_ptr<ast::many_matcher>(m);  return true; }() ) { return true; }
+								else { ps.pos = psStart; return false; } }();
+						case '+': 
+							return [&]() { 
+								parse::ind psStart = ps.pos;
+								if ( [&]() { 
+									parse::ind psStart = ps.pos;
+									if ( parse::matches<'+'>(ps)
+										&& _(ps) ) { return true; }
+									else { ps.pos = psStart; return false; } }()
+									&& [&]() { psVal = ast::make_ptr<ast::some_matcher>(m);  return true; }() ) { return true; }
+								else { ps.pos = psStart; return false; } }();
+						default:
+							return ps.expect(parse::expectation::named("[*+\?]"));
+						} }(); return true; }() ) { return true; }
+					else { ps.pos = psStart; return false; } }();
+			default:
+				return ps.expect(parse::expectation::named("[!\"&-(.;<A-[^_a-z]"));
+			} }() ) { return parse::match(std::move(psVal)); }
 		else { return parse::fail<ast::matcher_ptr >(); }
 
 	}
 
-	parse::result<ast::matcher_ptr > primary(parse::state& ps) {
+	parse::result<ast::matcher_ptr > primary(psState& ps) {
 		parse::ind psStart = ps.pos;
-		ast::matcher_ptr  psVal;
+		ast::matcher_ptr  psVal{};
 
 		ast::alt_matcher_ptr  am;
 		ast::seq_matcher_ptr  bm;
-		ast::char_matcher_ptr  cm;
+		ast::matcher_ptr  cm;
 		ast::range_matcher_ptr  rm;
 		std::string  s;
 		ast::str_matcher_ptr  sm;
 
-		if ( ( [&]() { 
-				parse::ind psStart = ps.pos;
-				if ( identifier(ps)(s)
-					&& [&]() {
+		if ( [&]() -> bool {
+			switch ( ps[ps.pos] ) {
+			case 'A': case 'B': case 'C': case 'D': case 'E': case 'F': case 'G': case 'H': 
+			case 'I': case 'J': case 'K': case 'L': case 'M': case 'N': case 'O': case 'P': 
+			case 'Q': case 'R': case 'S': case 'T': case 'U': case 'V': case 'W': case 'X': 
+			case 'Y': case 'Z': case '_': case 'a': case 'b': case 'c': case 'd': case 'e': 
+			case 'f': case 'g': case 'h': case 'i': case 'j': case 'k': case 'l': case 'm': 
+			case 'n': case 'o': case 'p': case 'q': case 'r': case 's': case 't': case 'u': 
+			case 'v': case 'w': case 'x': case 'y': case 'z': 
+				return [&]() { 
 					parse::ind psStart = ps.pos;
-					if ( [&]() { 
+					if ( identifier(ps)(s)
+						&& [&]() {
 						parse::ind psStart = ps.pos;
-						if ( [&]() { [&]() { 
+						ps.mute();
+						if ( [&]() { 
 							parse::ind psStart = ps.pos;
-							if ( BIND(ps)
-								&& type_id(ps) ) { return true; }
-							else { ps.pos = psStart; return false; } }(); return true; }()
-							&& EQUAL(ps) ) { return true; }
-						else { ps.pos = psStart; return false; } }() ) { ps.pos = psStart; return false; }
-					else { ps.pos = psStart; return true; } }()
-					&& [&]() { psVal = ast::make_ptr<ast::rule_matcher>(s);  return true; }()
-					&& [&]() { [&]() { 
+							if ( [&]() { [&]() { 
+								parse::ind psStart = ps.pos;
+								if ( [&]() { 
+									parse::ind psStart = ps.pos;
+									if ( parse::matches<':'>(ps)
+										&& _(ps) ) { return true; }
+									else { ps.pos = psStart; return false; } }()
+									&& type_id(ps) ) { return true; }
+								else { ps.pos = psStart; return false; } }(); return true; }()
+								&& [&]() { 
+								parse::ind psStart = ps.pos;
+								if ( parse::matches<'='>(ps)
+									&& _(ps) ) { return true; }
+								else { ps.pos = psStart; return false; } }() ) { return true; }
+							else { ps.pos = psStart; return false; } }() ) { ps.pos = psStart; ps.unmute(); return false; }
+						else { ps.pos = psStart; ps.unmute(); return true; } }()
+						&& [&]() { psVal = ast::make_ptr<ast::rule_matcher>(s);  return true; }()
+						&& [&]() { [&]() { 
+						parse::ind psStart = ps.pos;
+						if ( [&]() { 
+							parse::ind psStart = ps.pos;
+							if ( parse::matches<':'>(ps)
+								&& _(ps) ) { return true; }
+							else { ps.pos = psStart; return false; } }()
+							&& identifier(ps)(s)
+							&& [&]() { ast::as_ptr<ast::rule_matcher>(psVal)->var = s;  return true; }() ) { return true; }
+						else { ps.pos = psStart; return false; } }(); return true; }() ) { return true; }
+					else { ps.pos = psStart; return false; } }();
+			case '(': 
+				return [&]() { 
 					parse::ind psStart = ps.pos;
-					if ( BIND(ps)
-						&& identifier(ps)(s)
-						&& [&]() { ast::as_ptr<ast::rule_matcher>(psVal)->var = s;  return true; }() ) { return true; }
-					else { ps.pos = psStart; return false; } }(); return true; }() ) { return true; }
-				else { ps.pos = psStart; return false; } }()
-			|| [&]() { 
-				parse::ind psStart = ps.pos;
-				if ( OPEN(ps)
-					&& choice(ps)(am)
-					&& CLOSE(ps)
-					&& [&]() { psVal = am;  return true; }() ) { return true; }
-				else { ps.pos = psStart; return false; } }()
-			|| [&]() { 
-				parse::ind psStart = ps.pos;
-				if ( char_literal(ps)(cm)
-					&& [&]() { psVal = cm;  return true; }() ) { return true; }
-				else { ps.pos = psStart; return false; } }()
-			|| [&]() { 
-				parse::ind psStart = ps.pos;
-				if ( str_literal(ps)(sm)
-					&& [&]() { psVal = sm;  return true; }() ) { return true; }
-				else { ps.pos = psStart; return false; } }()
-			|| [&]() { 
-				parse::ind psStart = ps.pos;
-				if ( char_class(ps)(rm)
-					&& [&]() { psVal = rm;  return true; }() ) { return true; }
-				else { ps.pos = psStart; return false; } }()
-			|| [&]() { 
-				parse::ind psStart = ps.pos;
-				if ( ANY(ps)
-					&& [&]() { psVal = ast::make_ptr<ast::any_matcher>();  return true; }() ) { return true; }
-				else { ps.pos = psStart; return false; } }()
-			|| [&]() { 
-				parse::ind psStart = ps.pos;
-				if ( EMPTY(ps)
-					&& [&]() { psVal = ast::make_ptr<ast::empty_matcher>();  return true; }() ) { return true; }
-				else { ps.pos = psStart; return false; } }()
-			|| [&]() { 
-				parse::ind psStart = ps.pos;
-				if ( BEGIN(ps)
-					&& sequence(ps)(bm)
-					&& END(ps)
-					&& [&]() { psVal = ast::make_ptr<ast::capt_matcher>(bm);  return true; }() ) { return true; }
-				else { ps.pos = psStart; return false; } }() ) ) { return parse::match(psVal); }
+					if ( [&]() { 
+						parse::ind psStart = ps.pos;
+						if ( parse::matches<'('>(ps)
+							&& _(ps) ) { return true; }
+						else { ps.pos = psStart; return false; } }()
+						&& choice(ps)(am)
+						&& [&]() { 
+						parse::ind psStart = ps.pos;
+						if ( parse::matches<')'>(ps)
+							&& _(ps) ) { return true; }
+						else { ps.pos = psStart; return false; } }()
+						&& [&]() { psVal = am;  return true; }() ) { return true; }
+					else { ps.pos = psStart; return false; } }();
+			case '\'': 
+				return [&]() { 
+					parse::ind psStart = ps.pos;
+					if ( char_literal(ps)(cm)
+						&& [&]() { psVal = cm;  return true; }() ) { return true; }
+					else { ps.pos = psStart; return false; } }();
+			case '\"': 
+				return [&]() { 
+					parse::ind psStart = ps.pos;
+					if ( str_literal(ps)(sm)
+						&& [&]() { psVal = sm;  return true; }() ) { return true; }
+					else { ps.pos = psStart; return false; } }();
+			case '[': 
+				return [&]() { 
+					parse::ind psStart = ps.pos;
+					if ( char_class(ps)(rm)
+						&& [&]() { psVal = rm;  return true; }() ) { return true; }
+					else { ps.pos = psStart; return false; } }();
+			case '.': 
+				return [&]() { 
+					parse::ind psStart = ps.pos;
+					if ( [&]() { 
+						parse::ind psStart = ps.pos;
+						if ( parse::matches<'.'>(ps)
+							&& _(ps) ) { return true; }
+						else { ps.pos = psStart; return false; } }()
+						&& [&]() { psVal = ast::make_ptr<ast::any_matcher>();  return true; }() ) { return true; }
+					else { ps.pos = psStart; return false; } }();
+			case ';': 
+				return [&]() { 
+					parse::ind psStart = ps.pos;
+					if ( [&]() { 
+						parse::ind psStart = ps.pos;
+						if ( parse::matches<';'>(ps)
+							&& _(ps) ) { return true; }
+						else { ps.pos = psStart; return false; } }()
+						&& [&]() { psVal = ast::make_ptr<ast::empty_matcher>();  return true; }() ) { return true; }
+					else { ps.pos = psStart; return false; } }();
+			case '^': 
+				return [&]() { 
+					parse::ind psStart = ps.pos;
+					if ( [&]() { 
+						parse::ind psStart = ps.pos;
+						if ( parse::matches<'^'>(ps)
+							&& _(ps) ) { return true; }
+						else { ps.pos = psStart; return false; } }()
+						&& [&]() { psVal = ast::make_ptr<ast::cut_matcher>();  return true; }() ) { return true; }
+					else { ps.pos = psStart; return false; } }();
+			case '<': 
+				return [&]() { 
+					parse::ind psStart = ps.pos;
+					if ( [&]() { 
+						parse::ind psStart = ps.pos;
+						if ( parse::matches<'<'>(ps)
+							&& _(ps) ) { return true; }
+						else { ps.pos = psStart; return false; } }()
+						&& sequence(ps)(bm)
+						&& [&]() { 
+						parse::ind psStart = ps.pos;
+						if ( parse::matches<'>'>(ps)
+							&& _(ps) ) { return true; }
+						else { ps.pos = psStart; return false; } }()
+						&& [&]() { psVal = ast::make_ptr<ast::capt_matcher>(bm);  return true; }() ) { return true; }
+					else { ps.pos = psStart; return false; } }();
+			default:
+				return ps.expect(parse::expectation::named("[\"\'(.;<A-[^_a-z]"));
+			} }() ) { return parse::match(std::move(psVal)); }
 		else { return parse::fail<ast::matcher_ptr >(); }
 
 	}
 
-	parse::result<ast::action_matcher_ptr > action(parse::state& ps) {
+	parse::result<ast::action_matcher_ptr > action(psState& ps) {
 		parse::ind psStart = ps.pos;
-		ast::action_matcher_ptr  psVal;
+		ast::action_matcher_ptr  psVal{};
 
-		std::string psCapture;
+		parse::span psCapture;
 		parse::ind psCatch;
 		parse::ind psCatchLen;
 
@@ -471,43 +648,59 @@ namespace egg {
 			parse::ind psStart = ps.pos;
 			if ( [&]() {
 				parse::ind psStart = ps.pos;
-				if ( OUT_BEGIN(ps) ) { ps.pos = psStart; return false; }
-				else { ps.pos = psStart; return true; } }()
+				ps.mute();
+				if ( parse::literal(ps, "{%", 2) ) { ps.pos = psStart; ps.unmute(); return false; }
+				else { ps.pos = psStart; ps.unmute(); return true; } }()
 				&& parse::matches<'{'>(ps)
 				&& [&]() {
 				psCatch = ps.pos;
-				if ( [&]() { while ( ( action(ps)
-						|| [&]() { 
-							parse::ind psStart = ps.pos;
-							if ( [&]() {
+				if ( [&]() { while ( [&]() -> bool {
+						switch ( ps[ps.pos] ) {
+						case '\x00': 
+							return ps.expect(parse::expectation::named("any character"));
+						case '{': 
+							return action(ps)
+								|| [&]() { 
+								parse::ind psStart = ps.pos;
+								if ( [&]() {
+									parse::ind psStart = ps.pos;
+									ps.mute();
+									if ( parse::matches<'}'>(ps) ) { ps.pos = psStart; ps.unmute(); return false; }
+									else { ps.pos = psStart; ps.unmute(); return true; } }()
+									&& parse::any(ps) ) { return true; }
+								else { ps.pos = psStart; return false; } }();
+						default:
+							return [&]() { 
 								parse::ind psStart = ps.pos;
-								if ( parse::matches<'}'>(ps) ) { ps.pos = psStart; return false; }
-								else { ps.pos = psStart; return true; } }()
-								&& parse::any(ps) ) { return true; }
-							else { ps.pos = psStart; return false; } }() ) )
+								if ( [&]() {
+									parse::ind psStart = ps.pos;
+									ps.mute();
+									if ( parse::matches<'}'>(ps) ) { ps.pos = psStart; ps.unmute(); return false; }
+									else { ps.pos = psStart; ps.unmute(); return true; } }()
+									&& parse::any(ps) ) { return true; }
+								else { ps.pos = psStart; return false; } }();
+						} }() )
 					;
 				return true; }() ) {
 					psCatchLen = ps.pos - psCatch;
-					psCapture = ps.string(psCatch, psCatchLen);
 					return true;
 				} else {
 					psCatchLen = 0;
-					psCapture = std::string("");
 					return false;
 				} }()
 				&& parse::matches<'}'>(ps)
 				&& _(ps)
-				&& [&]() { psVal = ast::make_ptr<ast::action_matcher>(psCapture);  return true; }() ) { return true; }
-			else { ps.pos = psStart; return false; } }() ) { return parse::match(psVal); }
+				&& [&]() { psCapture = ps.view(psCatch, psCatchLen); psVal = ast::make_ptr<ast::action_matcher>(psCapture);  return true; }() ) { return true; }
+			else { ps.pos = psStart; return false; } }() ) { return parse::match(std::move(psVal)); }
 		else { return parse::fail<ast::action_matcher_ptr >(); }
 
 	}
 
-	parse::result<ast::char_matcher_ptr > char_literal(parse::state& ps) {
+	parse::result<ast::matcher_ptr > char_literal(psState& ps) {
 		parse::ind psStart = ps.pos;
-		ast::char_matcher_ptr  psVal;
+		ast::matcher_ptr  psVal{};
 
-		char  c;
+		char32_t  c;
 
 		if ( [&]() { 
 			parse::ind psStart = ps.pos;
@@ -515,17 +708,18 @@ namespace egg {
 				&& character(ps)(c)
 				&& parse::matches<'\''>(ps)
 				&& _(ps)
-				&& [&]() { psVal = ast::make_ptr<ast::char_matcher>(c);  return true; }() ) { return true; }
-			else { ps.pos = psStart; return false; } }() ) { return parse::match(psVal); }
-		else { return parse::fail<ast::char_matcher_ptr >(); }
+				&& [&]() { if ( c < 0x80 ) { psVal = ast::make_ptr<ast::char_matcher>(char(c)); }
+			  else { psVal = ast::make_ptr<ast::str_matcher>(strings::utf8(c)); }  return true; }() ) { return true; }
+			else { ps.pos = psStart; return false; } }() ) { return parse::match(std::move(psVal)); }
+		else { return parse::fail<ast::matcher_ptr >(); }
 
 	}
 
-	parse::result<ast::str_matcher_ptr > str_literal(parse::state& ps) {
+	parse::result<ast::str_matcher_ptr > str_literal(psState& ps) {
 		parse::ind psStart = ps.pos;
-		ast::str_matcher_ptr  psVal;
+		ast::str_matcher_ptr  psVal{};
 
-		std::string psCapture;
+		parse::span psCapture;
 		parse::ind psCatch;
 		parse::ind psCatchLen;
 
@@ -538,24 +732,22 @@ namespace egg {
 					;
 				return true; }() ) {
 					psCatchLen = ps.pos - psCatch;
-					psCapture = ps.string(psCatch, psCatchLen);
 					return true;
 				} else {
 					psCatchLen = 0;
-					psCapture = std::string("");
 					return false;
 				} }()
 				&& parse::matches<'\"'>(ps)
 				&& _(ps)
-				&& [&]() { psVal = ast::make_ptr<ast::str_matcher>(strings::unescape(psCapture));  return true; }() ) { return true; }
-			else { ps.pos = psStart; return false; } }() ) { return parse::match(psVal); }
+				&& [&]() { psCapture = ps.view(psCatch, psCatchLen); psVal = ast::make_ptr<ast::str_matcher>(strings::unescape(psCapture));  return true; }() ) { return true; }
+			else { ps.pos = psStart; return false; } }() ) { return parse::match(std::move(psVal)); }
 		else { return parse::fail<ast::str_matcher_ptr >(); }
 
 	}
 
-	parse::result<ast::range_matcher_ptr > char_class(parse::state& ps) {
+	parse::result<ast::range_matcher_ptr > char_class(psState& ps) {
 		parse::ind psStart = ps.pos;
-		ast::range_matcher_ptr  psVal;
+		ast::range_matcher_ptr  psVal{};
 
 		ast::char_range  r;
 
@@ -563,12 +755,38 @@ namespace egg {
 			parse::ind psStart = ps.pos;
 			if ( parse::matches<'['>(ps)
 				&& [&]() { psVal = ast::make_ptr<ast::range_matcher>();  return true; }()
+				&& [&]() { [&]() { 
+				parse::ind psStart = ps.pos;
+				if ( parse::matches<'^'>(ps)
+					&& [&]() { psVal->neg = true;  return true; }() ) { return true; }
+				else { ps.pos = psStart; return false; } }(); return true; }()
 				&& [&]() { while ( [&]() { 
 					parse::ind psStart = ps.pos;
 					if ( [&]() {
 						parse::ind psStart = ps.pos;
-						if ( parse::matches<']'>(ps) ) { ps.pos = psStart; return false; }
-						else { ps.pos = psStart; return true; } }()
+						ps.mute();
+						if ( parse::matches<']'>(ps) ) { ps.pos = psStart; ps.unmute(); return false; }
+						else { ps.pos = psStart; ps.unmute(); return true; } }()
+						&& [&]() { [&]() { 
+						parse::ind psStart = ps.pos;
+						if ( [&]() {
+							parse::ind psStart = ps.pos;
+							if ( [&]() { 
+								parse::ind psStart = ps.pos;
+								if ( [&]() { [&]() { 
+									parse::ind psStart = ps.pos;
+									if ( character(ps)
+										&& parse::matches<'-'>(ps) ) { return true; }
+									else { ps.pos = psStart; return false; } }(); return true; }()
+									&& ( [&]() {
+										const char* psW = ps.window(ps.pos, 2);
+										if ( psW[0] == '\\' && psSet2.contains(psW[1]) ) { ps.examined(ps.pos + 2); ps.pos += 2; return true; }
+										return false; }()
+									|| ( parse::matches<'\\'>(ps) && parse::in_set<psSet2>(ps) ) ) ) { return true; }
+								else { ps.pos = psStart; return false; } }() ) { ps.pos = psStart; return true; }
+							else { ps.pos = psStart; return false; } }()
+							&& [&]() { psVal->utf8 = true;  return true; }() ) { return true; }
+						else { ps.pos = psStart; return false; } }(); return true; }()
 						&& characters(ps)(r)
 						&& [&]() { *psVal += r;  return true; }() ) { return true; }
 					else { ps.pos = psStart; return false; } }() )
@@ -576,97 +794,223 @@ namespace egg {
 			return true; }()
 				&& parse::matches<']'>(ps)
 				&& _(ps) ) { return true; }
-			else { ps.pos = psStart; return false; } }() ) { return parse::match(psVal); }
+			else { ps.pos = psStart; return false; } }() ) { return parse::match(std::move(psVal)); }
 		else { return parse::fail<ast::range_matcher_ptr >(); }
 
 	}
 
-	parse::result<ast::char_range > characters(parse::state& ps) {
+	parse::result<ast::char_range > characters(psState& ps) {
 		parse::ind psStart = ps.pos;
-		ast::char_range  psVal;
+		ast::char_range  psVal{};
+
+		char32_t  c;
+		char32_t  f;
+		char32_t  t;
+
+		if ( [&]() -> bool {
+			switch ( ps[ps.pos] ) {
+			case '\x00': 
+				return ps.expect(parse::expectation::named("any character"));
+			default:
+				return [&]() { 
+					parse::ind psStart = ps.pos;
+					if ( character(ps)(f)
+						&& parse::matches<'-'>(ps)
+						&& character(ps)(t)
+						&& [&]() { psVal = ast::char_range(f,t);  return true; }() ) { return true; }
+					else { ps.pos = psStart; return false; } }()
+					|| [&]() { 
+					parse::ind psStart = ps.pos;
+					if ( character(ps)(c)
+						&& [&]() { psVal = ast::char_range(c);  return true; }() ) { return true; }
+					else { ps.pos = psStart; return false; } }();
+			} }() ) { return parse::match(std::move(psVal)); }
+		else { return parse::fail<ast::char_range >(); }
 
-		char  c;
-		char  f;
-		char  t;
+	}
 
-		if ( ( [&]() { 
-				parse::ind psStart = ps.pos;
-				if ( character(ps)(f)
-					&& parse::matches<'-'>(ps)
-					&& character(ps)(t)
-					&& [&]() { psVal = ast::char_range(f,t);  return true; }() ) { return true; }
-				else { ps.pos = psStart; return false; } }()
-			|| [&]() { 
+	parse::result<> unicode_escape(psState& ps) {
+		parse::ind psStart = ps.pos;
+
+
+		if ( [&]() { 
+			parse::ind psStart = ps.pos;
+			if ( [&]() { [&]() { 
 				parse::ind psStart = ps.pos;
-				if ( character(ps)(c)
-					&& [&]() { psVal = ast::char_range(c);  return true; }() ) { return true; }
-				else { ps.pos = psStart; return false; } }() ) ) { return parse::match(psVal); }
-		else { return parse::fail<ast::char_range >(); }
+				if ( character(ps)
+					&& parse::matches<'-'>(ps) ) { return true; }
+				else { ps.pos = psStart; return false; } }(); return true; }()
+				&& ( [&]() {
+					const char* psW = ps.window(ps.pos, 2);
+					if ( psW[0] == '\\' && psSet2.contains(psW[1]) ) { ps.examined(ps.pos + 2); ps.pos += 2; return true; }
+					return false; }()
+				|| ( parse::matches<'\\'>(ps) && parse::in_set<psSet2>(ps) ) ) ) { return true; }
+			else { ps.pos = psStart; return false; } }() ) { return parse::match(parse::val); }
+		else { return parse::fail<parse::value>(); }
 
 	}
 
-	parse::result<char > character(parse::state& ps) {
+	parse::result<char32_t > character(psState& ps) {
 		parse::ind psStart = ps.pos;
-		char  psVal;
+		char32_t  psVal{};
 
+		parse::span psCapture;
+		parse::ind psCatch;
+		parse::ind psCatchLen;
 
-		if ( ( [&]() { 
-				parse::ind psStart = ps.pos;
-				if ( parse::matches<'\\'>(ps)
-					&& ( parse::matches<'n'>(ps)
-					|| parse::matches<'r'>(ps)
-					|| parse::matches<'t'>(ps)
-					|| parse::matches<'\''>(ps)
-					|| parse::matches<'\"'>(ps)
-					|| parse::matches<'\\'>(ps) )
-					&& [&]() { psVal = strings::unescaped_char(ps[psStart+1]);  return true; }() ) { return true; }
-				else { ps.pos = psStart; return false; } }()
-			|| [&]() { 
-				parse::ind psStart = ps.pos;
-				if ( [&]() {
+		if ( [&]() -> bool {
+			switch ( ps[ps.pos] ) {
+			case '\x00': 
+				return ps.expect(parse::expectation::named("any character"));
+			case '\\': 
+				return [&]() { 
+					parse::ind psStart = ps.pos;
+					if ( parse::matches<'\\'>(ps)
+						&& [&]() -> bool {
+						switch ( ps[ps.pos] ) {
+						case 'u': 
+							return [&]() { 
+								parse::ind psStart = ps.pos;
+								if ( parse::matches<'u'>(ps)
+									&& [&]() {
+									psCatch = ps.pos;
+									if ( [&]() { 
+										parse::ind psStart = ps.pos;
+										if ( parse::in_set<psSet6>(ps)
+											&& parse::in_set<psSet6>(ps)
+											&& parse::in_set<psSet6>(ps)
+											&& parse::in_set<psSet6>(ps) ) { return true; }
+										else { ps.pos = psStart; return false; } }() ) {
+										psCatchLen = ps.pos - psCatch;
+										return true;
+									} else {
+										psCatchLen = 0;
+										return false;
+									} }()
+									&& [&]() { psCapture = ps.view(psCatch, psCatchLen); psVal = strings::code_point(psCapture);  return true; }() ) { return true; }
+								else { ps.pos = psStart; return false; } }();
+						case 'U': 
+							return [&]() { 
+								parse::ind psStart = ps.pos;
+								if ( parse::matches<'U'>(ps)
+									&& [&]() {
+									psCatch = ps.pos;
+									if ( [&]() { 
+										parse::ind psStart = ps.pos;
+										if ( parse::in_set<psSet6>(ps)
+											&& parse::in_set<psSet6>(ps)
+											&& parse::in_set<psSet6>(ps)
+											&& parse::in_set<psSet6>(ps)
+											&& parse::in_set<psSet6>(ps)
+											&& parse::in_set<psSet6>(ps)
+											&& parse::in_set<psSet6>(ps)
+											&& parse::in_set<psSet6>(ps) ) { return true; }
+										else { ps.pos = psStart; return false; } }() ) {
+										psCatchLen = ps.pos - psCatch;
+										return true;
+									} else {
+										psCatchLen = 0;
+										return false;
+									} }()
+									&& [&]() { psCapture = ps.view(psCatch, psCatchLen); psVal = strings::code_point(psCapture);  return true; }() ) { return true; }
+								else { ps.pos = psStart; return false; } }();
+						default:
+							return ps.expect(parse::expectation::named("[Uu]"));
+						} }() ) { return true; }
+					else { ps.pos = psStart; return false; } }()
+					|| [&]() { 
+					parse::ind psStart = ps.pos;
+					if ( ( [&]() {
+							const char* psW = ps.window(ps.pos, 2);
+							if ( psW[0] == '\\' && psSet3.contains(psW[1]) ) { ps.examined(ps.pos + 2); ps.pos += 2; return true; }
+							return false; }()
+						|| ( parse::matches<'\\'>(ps) && parse::in_set<psSet3>(ps) ) )
+						&& [&]() { psVal = (unsigned char)strings::unescaped_char(ps[psStart+1]);  return true; }() ) { return true; }
+					else { ps.pos = psStart; return false; } }()
+					|| [&]() { 
+					parse::ind psStart = ps.pos;
+					if ( [&]() {
+						parse::ind psStart = ps.pos;
+						ps.mute();
+						if ( parse::in_set<psSet5>(ps) ) { ps.pos = psStart; ps.unmute(); return false; }
+						else { ps.pos = psStart; ps.unmute(); return true; } }()
+						&& parse::any(ps)
+						&& [&]() { psVal = (unsigned char)ps[psStart];  return true; }() ) { return true; }
+					else { ps.pos = psStart; return false; } }();
+			case '\xc2': case '\xc3': case '\xc4': case '\xc5': case '\xc6': case '\xc7': case '\xc8': case '\xc9': 
+			case '\xca': case '\xcb': case '\xcc': case '\xcd': case '\xce': case '\xcf': case '\xd0': case '\xd1': 
+			case '\xd2': case '\xd3': case '\xd4': case '\xd5': case '\xd6': case '\xd7': case '\xd8': case '\xd9': 
+			case '\xda': case '\xdb': case '\xdc': case '\xdd': case '\xde': case '\xdf': case '\xe0': case '\xe1': 
+			case '\xe2': case '\xe3': case '\xe4': case '\xe5': case '\xe6': case '\xe7': case '\xe8': case '\xe9': 
+			case '\xea': case '\xeb': case '\xec': case '\xed': case '\xee': case '\xef': case '\xf0': case '\xf1': 
+			case '\xf2': case '\xf3': case '\xf4': 
+				return [&]() { 
 					parse::ind psStart = ps.pos;
-					if ( ( parse::matches<'\''>(ps)
-						|| parse::matches<'\"'>(ps)
-						|| parse::matches<'\\'>(ps) ) ) { ps.pos = psStart; return false; }
-					else { ps.pos = psStart; return true; } }()
-					&& parse::any(ps)
-					&& [&]() { psVal = ps[psStart];  return true; }() ) { return true; }
-				else { ps.pos = psStart; return false; } }() ) ) { return parse::match(psVal); }
-		else { return parse::fail<char >(); }
+					if ( [&]() {
+						psCatch = ps.pos;
+						if ( parse::in_codes<psSet4, psCodes0>(ps) ) {
+							psCatchLen = ps.pos - psCatch;
+							return true;
+						} else {
+							psCatchLen = 0;
+							return false;
+						} }()
+						&& [&]() { psCapture = ps.view(psCatch, psCatchLen); parse::decode_utf8(psCapture.data(), psCapture.size(), psVal);  return true; }() ) { return true; }
+					else { ps.pos = psStart; return false; } }()
+					|| [&]() { 
+					parse::ind psStart = ps.pos;
+					if ( [&]() {
+						parse::ind psStart = ps.pos;
+						ps.mute();
+						if ( parse::in_set<psSet5>(ps) ) { ps.pos = psStart; ps.unmute(); return false; }
+						else { ps.pos = psStart; ps.unmute(); return true; } }()
+						&& parse::any(ps)
+						&& [&]() { psVal = (unsigned char)ps[psStart];  return true; }() ) { return true; }
+					else { ps.pos = psStart; return false; } }();
+			default:
+				return [&]() { 
+					parse::ind psStart = ps.pos;
+					if ( [&]() {
+						parse::ind psStart = ps.pos;
+						ps.mute();
+						if ( parse::in_set<psSet5>(ps) ) { ps.pos = psStart; ps.unmute(); return false; }
+						else { ps.pos = psStart; ps.unmute(); return true; } }()
+						&& parse::any(ps)
+						&& [&]() { psVal = (unsigned char)ps[psStart];  return true; }() ) { return true; }
+					else { ps.pos = psStart; return false; } }();
+			} }() ) { return parse::match(std::move(psVal)); }
+		else { return parse::fail<char32_t >(); }
 
 	}
 
-	parse::result<> OUT_BEGIN(parse::state& ps) {
+	parse::result<> hex(psState& ps) {
 		parse::ind psStart = ps.pos;
 
 
-		if ( [&ps]() {
-			parse::ind psStart = ps.pos;
-
-			if ( '{' == ps[ps.pos++]
-			&& '%' == ps[ps.pos++] ) { return true; }
-			else { ps.pos= psStart; return false; }
-			}() ) { return parse::match(parse::val); }
+		if ( parse::in_set<psSet6>(ps) ) { return parse::match(parse::val); }
 		else { return parse::fail<parse::value>(); }
 
 	}
 
-	parse::result<> OUT_END(parse::state& ps) {
+	parse::result<> OUT_BEGIN(psState& ps) {
 		parse::ind psStart = ps.pos;
 
 
-		if ( [&ps]() {
-			parse::ind psStart = ps.pos;
+		if ( parse::literal(ps, "{%", 2) ) { return parse::match(parse::val); }
+		else { return parse::fail<parse::value>(); }
 
-			if ( '%' == ps[ps.pos++]
-			&& '}' == ps[ps.pos++] ) { return true; }
-			else { ps.pos= psStart; return false; }
-			}() ) { return parse::match(parse::val); }
+	}
+
+	parse::result<> OUT_END(psState& ps) {
+		parse::ind psStart = ps.pos;
+
+
+		if ( parse::literal(ps, "%}", 2) ) { return parse::match(parse::val); }
 		else { return parse::fail<parse::value>(); }
 
 	}
 
-	parse::result<> BIND(parse::state& ps) {
+	parse::result<> BIND(psState& ps) {
 		parse::ind psStart = ps.pos;
 
 
@@ -679,7 +1023,7 @@ namespace egg {
 
 	}
 
-	parse::result<> EQUAL(parse::state& ps) {
+	parse::result<> EQUAL(psState& ps) {
 		parse::ind psStart = ps.pos;
 
 
@@ -692,7 +1036,7 @@ namespace egg {
 
 	}
 
-	parse::result<> PIPE(parse::state& ps) {
+	parse::result<> PIPE(psState& ps) {
 		parse::ind psStart = ps.pos;
 
 
@@ -705,7 +1049,7 @@ namespace egg {
 
 	}
 
-	parse::result<> AND(parse::state& ps) {
+	parse::result<> AND(psState& ps) {
 		parse::ind psStart = ps.pos;
 
 
@@ -718,7 +1062,7 @@ namespace egg {
 
 	}
 
-	parse::result<> NOT(parse::state& ps) {
+	parse::result<> NOT(psState& ps) {
 		parse::ind psStart = ps.pos;
 
 
@@ -731,7 +1075,7 @@ namespace egg {
 
 	}
 
-	parse::result<> OPT(parse::state& ps) {
+	parse::result<> OPT(psState& ps) {
 		parse::ind psStart = ps.pos;
 
 
@@ -744,7 +1088,7 @@ namespace egg {
 
 	}
 
-	parse::result<> STAR(parse::state& ps) {
+	parse::result<> STAR(psState& ps) {
 		parse::ind psStart = ps.pos;
 
 
@@ -757,7 +1101,7 @@ namespace egg {
 
 	}
 
-	parse::result<> PLUS(parse::state& ps) {
+	parse::result<> PLUS(psState& ps) {
 		parse::ind psStart = ps.pos;
 
 
@@ -770,7 +1114,7 @@ namespace egg {
 
 	}
 
-	parse::result<> OPEN(parse::state& ps) {
+	parse::result<> OPEN(psState& ps) {
 		parse::ind psStart = ps.pos;
 
 
@@ -783,7 +1127,7 @@ namespace egg {
 
 	}
 
-	parse::result<> CLOSE(parse::state& ps) {
+	parse::result<> CLOSE(psState& ps) {
 		parse::ind psStart = ps.pos;
 
 
@@ -796,7 +1140,7 @@ namespace egg {
 
 	}
 
-	parse::result<> ANY(parse::state& ps) {
+	parse::result<> ANY(psState& ps) {
 		parse::ind psStart = ps.pos;
 
 
@@ -809,7 +1153,7 @@ namespace egg {
 
 	}
 
-	parse::result<> EMPTY(parse::state& ps) {
+	parse::result<> EMPTY(psState& ps) {
 		parse::ind psStart = ps.pos;
 
 
@@ -822,7 +1166,20 @@ namespace egg {
 
 	}
 
-	parse::result<> BEGIN(parse::state& ps) {
+	parse::result<> CUT(psState& ps) {
+		parse::ind psStart = ps.pos;
+
+
+		if ( [&]() { 
+			parse::ind psStart = ps.pos;
+			if ( parse::matches<'^'>(ps)
+				&& _(ps) ) { return true; }
+			else { ps.pos = psStart; return false; } }() ) { return parse::match(parse::val); }
+		else { return parse::fail<parse::value>(); }
+
+	}
+
+	parse::result<> BEGIN(psState& ps) {
 		parse::ind psStart = ps.pos;
 
 
@@ -835,7 +1192,7 @@ namespace egg {
 
 	}
 
-	parse::result<> END(parse::state& ps) {
+	parse::result<> END(psState& ps) {
 		parse::ind psStart = ps.pos;
 
 
@@ -848,30 +1205,122 @@ namespace egg {
 
 	}
 
-	parse::result<> _(parse::state& ps) {
+	parse::result<> _(psState& ps) {
 		parse::ind psStart = ps.pos;
 
 
-		if ( [&]() { while ( ( space(ps)
-				|| comment(ps) ) )
+		if ( [&]() { while ( [&]() -> bool {
+				switch ( ps[ps.pos] ) {
+				case '\t': case '\n': case '\r': case ' ': 
+					return [&]() -> bool {
+						switch ( ps[ps.pos] ) {
+						case '\t': case ' ': 
+							return parse::in_set<psSet7>(ps);
+						case '\n': case '\r': 
+							return [&]() -> bool {
+								const char* psW = ps.window(ps.pos, 2);
+								switch ( psW[0] ) {
+								case '\r':
+									switch ( psW[1] ) {
+									case '\n':
+										ps.examined(ps.pos + 2); ps.pos += 2; return true;
+									default:
+										ps.examined(ps.pos + 2); ps.expect(parse::expectation::string("\r\n", 2)); ps.pos += 1; return true;
+									}
+								case '\n':
+									ps.examined(ps.pos + 1); ps.pos += 1; return true;
+								default:
+									ps.examined(ps.pos + 1); ps.expect(parse::expectation::named("[\\n\\r]")); return false;
+								} }();
+						default:
+							return ps.expect(parse::expectation::named("[\\t\\n\\r ]"));
+						} }();
+				case '#': 
+					return [&]() { 
+						parse::ind psStart = ps.pos;
+						if ( parse::matches<'#'>(ps)
+							&& [&]() { while ( [&]() { 
+								parse::ind psStart = ps.pos;
+								if ( [&]() {
+									parse::ind psStart = ps.pos;
+									ps.mute();
+									if ( [&]() -> bool {
+										const char* psW = ps.window(ps.pos, 2);
+										switch ( psW[0] ) {
+										case '\r':
+											switch ( psW[1] ) {
+											case '\n':
+												ps.examined(ps.pos + 2); ps.pos += 2; return true;
+											default:
+												ps.examined(ps.pos + 2); ps.expect(parse::expectation::string("\r\n", 2)); ps.pos += 1; return true;
+											}
+										case '\n':
+											ps.examined(ps.pos + 1); ps.pos += 1; return true;
+										default:
+											ps.examined(ps.pos + 1); ps.expect(parse::expectation::named("[\\n\\r]")); return false;
+										} }() ) { ps.pos = psStart; ps.unmute(); return false; }
+									else { ps.pos = psStart; ps.unmute(); return true; } }()
+									&& parse::any(ps) ) { return true; }
+								else { ps.pos = psStart; return false; } }() )
+							;
+						return true; }()
+							&& [&]() -> bool {
+							const char* psW = ps.window(ps.pos, 2);
+							switch ( psW[0] ) {
+							case '\r':
+								switch ( psW[1] ) {
+								case '\n':
+									ps.examined(ps.pos + 2); ps.pos += 2; return true;
+								default:
+									ps.examined(ps.pos + 2); ps.expect(parse::expectation::string("\r\n", 2)); ps.pos += 1; return true;
+								}
+							case '\n':
+								ps.examined(ps.pos + 1); ps.pos += 1; return true;
+							default:
+								ps.examined(ps.pos + 1); ps.expect(parse::expectation::named("[\\n\\r]")); return false;
+							} }() ) { return true; }
+						else { ps.pos = psStart; return false; } }();
+				default:
+					return ps.expect(parse::expectation::named("[\\t\\n\\r #]"));
+				} }() )
 			;
 		return true; }() ) { return parse::match(parse::val); }
 		else { return parse::fail<parse::value>(); }
 
 	}
 
-	parse::result<> space(parse::state& ps) {
+	parse::result<> space(psState& ps) {
 		parse::ind psStart = ps.pos;
 
 
-		if ( ( parse::matches<' '>(ps)
-			|| parse::matches<'\t'>(ps)
-			|| end_of_line(ps) ) ) { return parse::match(parse::val); }
+		if ( [&]() -> bool {
+			switch ( ps[ps.pos] ) {
+			case '\t': case ' ': 
+				return parse::in_set<psSet7>(ps);
+			case '\n': case '\r': 
+				return [&]() -> bool {
+					const char* psW = ps.window(ps.pos, 2);
+					switch ( psW[0] ) {
+					case '\r':
+						switch ( psW[1] ) {
+						case '\n':
+							ps.examined(ps.pos + 2); ps.pos += 2; return true;
+						default:
+							ps.examined(ps.pos + 2); ps.expect(parse::expectation::string("\r\n", 2)); ps.pos += 1; return true;
+						}
+					case '\n':
+						ps.examined(ps.pos + 1); ps.pos += 1; return true;
+					default:
+						ps.examined(ps.pos + 1); ps.expect(parse::expectation::named("[\\n\\r]")); return false;
+					} }();
+			default:
+				return ps.expect(parse::expectation::named("[\\t\\n\\r ]"));
+			} }() ) { return parse::match(parse::val); }
 		else { return parse::fail<parse::value>(); }
 
 	}
 
-	parse::result<> comment(parse::state& ps) {
+	parse::result<> comment(psState& ps) {
 		parse::ind psStart = ps.pos;
 
 
@@ -882,43 +1331,79 @@ namespace egg {
 					parse::ind psStart = ps.pos;
 					if ( [&]() {
 						parse::ind psStart = ps.pos;
-						if ( end_of_line(ps) ) { ps.pos = psStart; return false; }
-						else { ps.pos = psStart; return true; } }()
+						ps.mute();
+						if ( [&]() -> bool {
+							const char* psW = ps.window(ps.pos, 2);
+							switch ( psW[0] ) {
+							case '\r':
+								switch ( psW[1] ) {
+								case '\n':
+									ps.examined(ps.pos + 2); ps.pos += 2; return true;
+								default:
+									ps.examined(ps.pos + 2); ps.expect(parse::expectation::string("\r\n", 2)); ps.pos += 1; return true;
+								}
+							case '\n':
+								ps.examined(ps.pos + 1); ps.pos += 1; return true;
+							default:
+								ps.examined(ps.pos + 1); ps.expect(parse::expectation::named("[\\n\\r]")); return false;
+							} }() ) { ps.pos = psStart; ps.unmute(); return false; }
+						else { ps.pos = psStart; ps.unmute(); return true; } }()
 						&& parse::any(ps) ) { return true; }
 					else { ps.pos = psStart; return false; } }() )
 				;
 			return true; }()
-				&& end_of_line(ps) ) { return true; }
+				&& [&]() -> bool {
+				const char* psW = ps.window(ps.pos, 2);
+				switch ( psW[0] ) {
+				case '\r':
+					switch ( psW[1] ) {
+					case '\n':
+						ps.examined(ps.pos + 2); ps.pos += 2; return true;
+					default:
+						ps.examined(ps.pos + 2); ps.expect(parse::expectation::string("\r\n", 2)); ps.pos += 1; return true;
+					}
+				case '\n':
+					ps.examined(ps.pos + 1); ps.pos += 1; return true;
+				default:
+					ps.examined(ps.pos + 1); ps.expect(parse::expectation::named("[\\n\\r]")); return false;
+				} }() ) { return true; }
 			else { ps.pos = psStart; return false; } }() ) { return parse::match(parse::val); }
 		else { return parse::fail<parse::value>(); }
 
 	}
 
-	parse::result<> end_of_line(parse::state& ps) {
+	parse::result<> end_of_line(psState& ps) {
 		parse::ind psStart = ps.pos;
 
 
-		if ( ( [&ps]() {
-				parse::ind psStart = ps.pos;
-
-				if ( '\r' == ps[ps.pos++]
-				&& '\n' == ps[ps.pos++] ) { return true; }
-				else { ps.pos= psStart; return false; }
-				}()
-			|| parse::matches<'\n'>(ps)
-			|| parse::matches<'\r'>(ps) ) ) { return parse::match(parse::val); }
+		if ( [&]() -> bool {
+			const char* psW = ps.window(ps.pos, 2);
+			switch ( psW[0] ) {
+			case '\r':
+				switch ( psW[1] ) {
+				case '\n':
+					ps.examined(ps.pos + 2); ps.pos += 2; return true;
+				default:
+					ps.examined(ps.pos + 2); ps.expect(parse::expectation::string("\r\n", 2)); ps.pos += 1; return true;
+				}
+			case '\n':
+				ps.examined(ps.pos + 1); ps.pos += 1; return true;
+			default:
+				ps.examined(ps.pos + 1); ps.expect(parse::expectation::named("[\\n\\r]")); return false;
+			} }() ) { return parse::match(parse::val); }
 		else { return parse::fail<parse::value>(); }
 
 	}
 
-	parse::result<> end_of_file(parse::state& ps) {
+	parse::result<> end_of_file(psState& ps) {
 		parse::ind psStart = ps.pos;
 
 
 		if ( [&]() {
 			parse::ind psStart = ps.pos;
-			if ( parse::any(ps) ) { ps.pos = psStart; return false; }
-			else { ps.pos = psStart; return true; } }() ) { return parse::match(parse::val); }
+			ps.mute();
+			if ( parse::any(ps) ) { ps.pos = psStart; ps.unmute(); return false; }
+			else { ps.pos = psStart; ps.unmute(); return true; } }() ) { return parse::match(parse::val); }
 		else { return parse::fail<parse::value>(); }
 
 	}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2013 Aaron Moss
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * Benchmark driver for a generated parser. Compile with BENCH_GRAMMAR 
+ * defined to the (quoted) generated header, and BENCH_RULE to the rule to 
+ * match; the rule is matched against each line of the input, or against 
+ * the whole input if BENCH_WHOLE is defined (BENCH_AST additionally sets 
+ * up an AST arena for egg.egg). For the best of a number of runs, it 
+ * reports throughput, the heap allocations made, and the peak resident 
+ * set size of the process (which includes the memory-mapped input).
+ * @author Aaron Moss
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+
+#include <sys/resource.h>
+
+/** Heap allocations and bytes allocated since the start of the current 
+ *  run */
+static std::atomic<unsigned long> allocs(0), alloc_bytes(0);
+
+void* operator new(std::size_t n) {
+	++allocs;
+	alloc_bytes += n;
+	if ( void* p = std::malloc(n ? n : 1) ) return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t n) { return operator new(n); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+
+//the grammar's own test harness is not run
+#define main psHarnessMain
+#include BENCH_GRAMMAR
+#undef main
+
+/** Matches the rule against the input, as configured above.
+ *  @return the number of matches, out of the given number of parses */
+static unsigned long run(const parse::mapped_file& f, unsigned long& parses) {
+	unsigned long matched = 0;
+	parses = 0;
+#ifdef BENCH_WHOLE
+#ifdef BENCH_AST
+	parse::arena nodes;
+	ast::arena_scope scope(nodes);
+#endif
+	parse::state ps(f);
+	if ( BENCH_RULE(ps) ) ++matched;
+	++parses;
+#else
+	const char* it = f.data();
+	const char* end = f.data() + f.size();
+	while ( it < end ) {
+		const char* nl = static_cast<const char*>(std::memchr(it, '\n', end - it));
+		if ( ! nl ) nl = end;
+		parse::state ps(it, nl - it);
+		if ( BENCH_RULE(ps) ) ++matched;
+		++parses;
+		it = nl + 1;
+	}
+#endif
+	return matched;
+}
+
+/** Usage: bench INPUT [RUNS] */
+int main(int argc, char** argv) {
+	if ( argc < 2 ) {
+		std::fprintf(stderr, "Usage: %s INPUT [RUNS]\n", argv[0]);
+		return 1;
+	}
+	const char* name = std::strrchr(argv[0], '/');
+	name = name ? name + 1 : argv[0];
+	if ( std::strncmp(name, "bench_", 6) == 0 ) name += 6;
+	int runs = argc > 2 ? std::atoi(argv[2]) : 3;
+
+	parse::mapped_file f(argv[1]);
+	double mb = f.size() / (1024.0 * 1024.0);
+	double best = 0;
+	unsigned long matched = 0, parses = 0, n_allocs = 0, n_bytes = 0;
+	for (int i = 0; i < runs || i == 0; ++i) {
+		allocs = 0;
+		alloc_bytes = 0;
+		auto t = std::chrono::steady_clock::now();
+		matched = run(f, parses);
+		double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+		if ( i == 0 || s < best ) best = s;
+		n_allocs = allocs;
+		n_bytes = alloc_bytes;
+	}
+
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	std::printf("%-14s %9.1f %9.3f %9.1f %12lu %10.1f %9.1f %12lu/%lu\n", 
+	            name, mb, best, mb / best, n_allocs, n_bytes / (1024.0 * 1024.0), 
+	            ru.ru_maxrss / 1024.0, matched, parses);
+	return 0;
+}
@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2013 Aaron Moss
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+/**
+ * Generates large synthetic inputs for the benchmark grammars; output is 
+ * deterministic for a given grammar, size, and seed.
+ * @author Aaron Moss
+ */
+
+/** xorshift64* pseudo-random number generator */
+class rng {
+public:
+	rng(uint64_t seed) : x(seed ? seed : 1) {}
+
+	/** @return a random number in [0, n) */
+	unsigned long below(unsigned long n) {
+		x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+		return (unsigned long)((x * 0x2545F4914F6CDD1Dull) >> 32) % n;
+	}
+
+	/** @return true with probability 1/n */
+	bool one_in(unsigned long n) { return below(n) == 0; }
+
+private:
+	uint64_t x;
+}; /* class rng */
+
+/** Generates lines of arithmetic for calc.egg. Multipliers and divisors 
+ *  are non-zero digits and parentheses nest at most 3 deep, so no line 
+ *  overflows an int or divides by zero. */
+class calc_gen {
+public:
+	calc_gen(rng& r) : r(r) {}
+
+	void line(std::string& s) {
+		sum(s, 3);
+		s += '\n';
+	}
+
+private:
+	void sum(std::string& s, int depth) {
+		prod(s, depth);
+		for (unsigned long n = r.below(5); n > 0; --n) {
+			s += r.one_in(2) ? '+' : '-';
+			prod(s, depth);
+		}
+	}
+
+	void prod(std::string& s, int depth) {
+		if ( depth > 0 && r.one_in(3) ) {
+			s += '(';
+			sum(s, depth - 1);
+			s += ')';
+		} else {
+			s += std::to_string(r.below(1000));
+		}
+		for (unsigned long n = r.below(3); n > 0; --n) {
+			s += r.one_in(2) ? '*' : '/';
+			s += char('1' + r.below(9));
+		}
+	}
+
+	rng& r;
+}; /* class calc_gen */
+
+/** Generates lines for abc.egg, about half of which match */
+class abc_gen {
+public:
+	abc_gen(rng& r) : r(r) {}
+
+	void line(std::string& s) {
+		switch ( r.below(4) ) {
+		case 0: s += "abc"; break;
+		case 1: s.append(r.below(64), 'a'); s += 'c'; break;
+		case 2: s.append(r.below(64), 'a'); s += "bc"; break;
+		default: s.append(1 + r.below(64), 'a'); break;
+		}
+		s += '\n';
+	}
+
+private:
+	rng& r;
+}; /* class abc_gen */
+
+/** Generates lines of a^n b^n c^n for anbncn.egg, one in four of which 
+ *  has one of the counts off by one, and so doesn't match */
+class anbncn_gen {
+public:
+	anbncn_gen(rng& r) : r(r) {}
+
+	void line(std::string& s) {
+		unsigned long n[3];
+		n[0] = n[1] = n[2] = 1 + r.below(128);
+		if ( r.one_in(4) ) ++n[r.below(3)];
+		s.append(n[0], 'a');
+		s.append(n[1], 'b');
+		s.append(n[2], 'c');
+		s += '\n';
+	}
+
+private:
+	rng& r;
+}; /* class anbncn_gen */
+
+/** Generates a grammar for egg.egg, as a sequence of rules built from all 
+ *  the kinds of matcher in the Egg grammar */
+class egg_gen {
+public:
+	egg_gen(rng& r) : r(r), n(0) {}
+
+	void line(std::string& s) {
+		if ( r.one_in(8) ) s += "# rule " + std::to_string(n) + "\n";
+		if ( r.one_in(8) ) s += "%memo\n";
+		s += "rule" + std::to_string(n);
+		if ( r.one_in(2) ) s += " : int";
+		s += " =\t";
+		choice(s, 2);
+		s += "\n\n";
+		++n;
+	}
+
+private:
+	void choice(std::string& s, int depth) {
+		sequence(s, depth);
+		for (unsigned long k = r.below(3); k > 0; --k) {
+			s += "\n\t\t| ";
+			sequence(s, depth);
+		}
+	}
+
+	void sequence(std::string& s, int depth) {
+		for (unsigned long k = 1 + r.below(4); k > 0; --k) {
+			if ( r.one_in(6) ) {
+				s += "{ psVal += " + std::to_string(r.below(100)) + "; } ";
+				continue;
+			}
+			//lookahead matchers can't also be repeated
+			switch ( r.below(8) ) {
+			case 0: s += '&'; primary(s, depth); break;
+			case 1: s += '!'; primary(s, depth); break;
+			case 2: primary(s, depth); s += '?'; break;
+			case 3: primary(s, depth); s += '*'; break;
+			case 4: primary(s, depth); s += '+'; break;
+			default: primary(s, depth); break;
+			}
+			s += ' ';
+		}
+	}
+
+	void primary(std::string& s, int depth) {
+		switch ( r.below(depth > 0 ? 9 : 7) ) {
+		case 0: s += "rule" + std::to_string(r.below(n + 1)); break;
+		case 1: s += "rule" + std::to_string(r.below(n + 1)) + " : x"; break;
+		case 2: s += '\''; s += char('a' + r.below(26)); s += '\''; break;
+		case 3: s += "\"egg" + std::to_string(r.below(1000)) + "\\n\""; break;
+		case 4: s += "[a-z_0-9\\t]"; break;
+		case 5: s += "[^\\n]"; break;
+		case 6: s += '.'; break;
+		case 7: s += "( "; choice(s, depth - 1); s += " )"; break;
+		default: s += "< "; sequence(s, depth - 1); s += "> "; break;
+		}
+	}
+
+	rng& r;
+	unsigned long n;	/**< index of the current rule */
+}; /* class egg_gen */
+
+/** Writes lines from the generator g until at least bytes bytes have been 
+ *  written */
+template<typename G>
+void generate(G g, unsigned long bytes) {
+	std::string s;
+	unsigned long written = 0;
+	while ( written < bytes ) {
+		s.clear();
+		while ( s.size() < 65536 && written + s.size() < bytes ) g.line(s);
+		std::cout.write(s.data(), s.size());
+		written += s.size();
+	}
+}
+
+/** Usage: gen GRAMMAR MB [SEED] */
+int main(int argc, char** argv) {
+	if ( argc < 3 ) {
+		std::cerr << "Usage: " << argv[0] << " calc|abc|anbncn|egg MB [SEED]" << std::endl;
+		return 1;
+	}
+	std::string g = argv[1];
+	unsigned long bytes = (unsigned long)(std::atof(argv[2]) * 1024 * 1024);
+	rng r(argc > 3 ? std::strtoull(argv[3], 0, 10) : 1);
+
+	if ( g == "calc" ) generate(calc_gen(r), bytes);
+	else if ( g == "abc" ) generate(abc_gen(r), bytes);
+	else if ( g == "anbncn" ) generate(anbncn_gen(r), bytes);
+	else if ( g == "egg" ) generate(egg_gen(r), bytes);
+	else {
+		std::cerr << "Unknown grammar `" << g << "'" << std::endl;
+		return 1;
+	}
+	return 0;
+}
@@ -20,15 +20,21 @@
  * THE SOFTWARE.
  */
 
-#include <cmath>
+#include <chrono>
+#include <cstdlib>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "egg.hpp"
 #include "parse.hpp"
 #include "visitors/compiler.hpp"
+#include "visitors/interpreter.hpp"
 #include "visitors/normalizer.hpp"
+#include "visitors/optimizer.hpp"
 #include "visitors/printer.hpp"
 
 /** Egg version */
@@ -36,7 +42,7 @@ static const char* VERSION = "0.1.0";
 
 /** Egg usage string */
 static const char* USAGE = 
-"[-c print|compile] [-i input_file] [-o output_file] [--no-norm] [--help] [--version] [--usage]";
+"[-c print|compile|match] [-i input_file] [-o output_file] [-m match_file] [--no-norm] [--no-opt] [--memo] [--flat] [--parallel] [--profile] [--sax] [--cst] [--stats] [--state TYPE] [--inline N] [--time-phases] [--help] [--version] [--usage]";
 
 /** Full Egg help string */
 static const char* HELP = 
@@ -45,12 +51,32 @@ static const char* HELP =
 Supported flags are\n\
  -i --input    input file (default stdin)\n\
  -o --output   output file (default stdout)\n\
- -c --command  command - either compile, print, help, usage, or version\n\
-               (default compile)\n\
+ -c --command  command - either compile, print, match, help, usage, or\n\
+               version (default compile)\n\
+ -m --match    file to match against the grammar with the interpreter\n\
+               (sets command to match; default stdin)\n\
  -n --name     grammar name - if none given, takes the longest prefix of\n\
                the input or output file name (output preferred) which is a\n\
                valid Egg identifier (default empty)\n\
  --no-norm     turns off grammar normalization\n\
+ --no-opt      turns off grammar optimization\n\
+ --memo        memoize the results of all rules (packrat parsing)\n\
+ --flat        generate flat code using gotos rather than nested lambdas\n\
+ --parallel    generate a parse_parallel() driver, which matches the\n\
+               records of a file with the first rule on multiple threads\n\
+ --profile     record the calls, failures and time of each rule, printed\n\
+               by the generated dump_profile()\n\
+ --sax         generate untyped rules without semantic actions, which\n\
+               report each rule matched to a handler\n\
+ --cst         record each rule matched as a node of the concrete syntax\n\
+               tree of the parser state\n\
+ --stats       count input, backtracking and memo use in the parser\n\
+               state, printed by the generated dump_stats()\n\
+ --inline N    splice untyped, non-recursive rules of at most N matchers\n\
+               into their callers (default 16; 0 for none)\n\
+ --state TYPE  type of parser state the generated rules take, e.g.\n\
+               parse::unchecked_state (default parse::state)\n\
+ --time-phases print the time taken by each phase of egg to stderr\n\
  --usage       print usage message\n\
  --help        print full help message\n\
  --version     print version string\n";
@@ -59,6 +85,7 @@ Supported flags are\n\
 enum egg_mode {
 	PRINT_MODE,		/**< Print grammar */
 	COMPILE_MODE,	/**< Compile grammar */
+	MATCH_MODE,		/**< Match input against grammar */
 	USAGE_MODE,     /**< Print usage */
 	HELP_MODE,      /**< Print help */
 	VERSION_MODE    /**< Print version */
@@ -103,6 +130,9 @@ private:
 		} else if ( eq("compile", s) ) {
 			eMode = COMPILE_MODE;
 			return true;
+		} else if ( eq("match", s) ) {
+			eMode = MATCH_MODE;
+			return true;
 		} else if ( eq("help", s) ) {
 			eMode = HELP_MODE;
 			return true;
@@ -118,7 +148,7 @@ private:
 	}
 
 	void parse_input(char* s) {
-		in = new std::ifstream(s);
+		iName = std::string(s);
 		if ( !nameFlag && out == 0 ) {
 			pName = id_prefix(s);
 		}
@@ -131,6 +161,11 @@ private:
 		}
 	}
 
+	void parse_match(char* s) {
+		mName = std::string(s);
+		eMode = MATCH_MODE;
+	}
+
 	void parse_name(char* s) {
 		pName = id_prefix(s);
 		nameFlag = true;
@@ -138,11 +173,23 @@ private:
 
 public:
 	args(int argc, char** argv) {
-		in = (std::ifstream*)0;
 		out = (std::ofstream*)0;
+		iName = std::string("");
 		pName = std::string("");
+		mName = std::string("");
 		nameFlag = false;
 		normFlag = true;
+		optFlag = true;
+		memoFlag = false;
+		flatFlag = false;
+		parallelFlag = false;
+		profileFlag = false;
+		saxFlag = false;
+		cstFlag = false;
+		statsFlag = false;
+		timeFlag = false;
+		inlineSize = visitor::compiler_options().inline_size;
+		stateType = visitor::compiler_options().state;
 		eMode = COMPILE_MODE;
 
 		i = 1;
@@ -165,8 +212,35 @@ public:
 			} else if ( match("-n", "--name", argv[i]) ) {
 				if ( i+1 >= argc ) return;
 				parse_name(argv[++i]);
+			} else if ( match("-m", "--match", argv[i]) ) {
+				if ( i+1 >= argc ) return;
+				parse_match(argv[++i]);
 			} else if ( eq("--no-norm", argv[i]) ) {
 				normFlag = false;
+			} else if ( eq("--no-opt", argv[i]) ) {
+				optFlag = false;
+			} else if ( eq("--memo", argv[i]) ) {
+				memoFlag = true;
+			} else if ( eq("--flat", argv[i]) ) {
+				flatFlag = true;
+			} else if ( eq("--parallel", argv[i]) ) {
+				parallelFlag = true;
+			} else if ( eq("--profile", argv[i]) ) {
+				profileFlag = true;
+			} else if ( eq("--sax", argv[i]) ) {
+				saxFlag = true;
+			} else if ( eq("--cst", argv[i]) ) {
+				cstFlag = true;
+			} else if ( eq("--stats", argv[i]) ) {
+				statsFlag = true;
+			} else if ( eq("--inline", argv[i]) ) {
+				if ( i+1 >= argc ) return;
+				inlineSize = std::strtoul(argv[++i], 0, 10);
+			} else if ( eq("--state", argv[i]) ) {
+				if ( i+1 >= argc ) return;
+				stateType = argv[++i];
+			} else if ( eq("--time-phases", argv[i]) ) {
+				timeFlag = true;
 			} else if ( eq("--usage", argv[i]) ) {
 				eMode = USAGE_MODE;
 			} else if ( eq("--help", argv[i]) ) {
@@ -185,38 +259,178 @@ public:
 		}
 	}
 
-	~args() {
-		if ( in != 0 ) in->close();
-	}
-
-	std::istream& input() { if ( in ) return *in; else return std::cin; }
+	std::string input_file() { return iName; }
 	std::ostream& output() { if ( out ) return *out; else return std::cout; }
 	std::string name() { return pName; }
+	std::string match_file() { return mName; }
 	bool norm() { return normFlag; }
+	bool opt() { return optFlag; }
+	bool memo() { return memoFlag; }
+	bool flat() { return flatFlag; }
+	bool parallel() { return parallelFlag; }
+	bool profile() { return profileFlag; }
+	bool sax() { return saxFlag; }
+	bool cst() { return cstFlag; }
+	bool stats() { return statsFlag; }
+	bool time_phases() { return timeFlag; }
+	unsigned long inline_size() { return inlineSize; }
+	std::string state_type() { return stateType; }
 	egg_mode mode() { return eMode; }
 
 private:
 	int i;				/**< next unparsed value */
-	std::ifstream* in;	/**< pointer to input stream (0 for stdin) */
 	std::ofstream* out;	/**< pointer to output stream (0 for stdout) */
+	std::string iName;	/**< the input file (empty for stdin) */
 	std::string pName;	/**< the name of the parser (empty if none) */
+	std::string mName;	/**< the file to match (empty for stdin) */
 	bool nameFlag;		/**< has the parser name been explicitly set? */
 	bool normFlag;      /**< should egg do grammar normalization? */
+	bool optFlag;       /**< should egg do grammar optimization? */
+	bool memoFlag;      /**< should egg memoize all rules? */
+	bool flatFlag;      /**< should egg generate lambda-free code? */
+	bool parallelFlag;  /**< should egg generate a parallel driver? */
+	bool profileFlag;   /**< should egg generate profiled rules? */
+	bool saxFlag;       /**< should egg generate event-reporting rules? */
+	bool cstFlag;       /**< should egg generate tree-building rules? */
+	bool statsFlag;     /**< should egg generate rules counting resets? */
+	bool timeFlag;      /**< should egg report the time of each phase? */
+	unsigned long inlineSize;	/**< largest size of rule to inline */
+	std::string stateType;		/**< type of parser state to generate for */
 	egg_mode eMode;		/**< compiler mode to use */
 };
 
+/** Times the phases of a run of egg, reporting them to std::cerr for 
+ *  --time-phases */
+class phase_timer {
+	typedef std::chrono::steady_clock clock;
+public:
+	phase_timer(bool on) : on(on), start(clock::now()), last(start) {}
+	
+	/** Ends the current phase, which began when the last one ended */
+	void end(const char* phase) {
+		if ( ! on ) return;
+		clock::time_point now = clock::now();
+		report(phase, now - last);
+		last = now;
+	}
+	
+	/** Reports the total time, if any phase was timed */
+	~phase_timer() {
+		if ( on && last != start ) report("total", last - start);
+	}
+
+private:
+	void report(const char* phase, clock::duration d) {
+		std::cerr << std::left << std::setw(12) << phase << std::right << std::fixed 
+		          << std::setprecision(3) << std::setw(10) 
+		          << std::chrono::duration<double, std::milli>(d).count() << " ms" << std::endl;
+	}
+	
+	bool on;				/**< are phases being timed? */
+	clock::time_point start;	/**< start of the first phase */
+	clock::time_point last;		/**< end of the last phase */
+};
+
+/** Prints a description of the furthest position a failed parse reached, 
+ *  and the terminals expected there, to std::cerr */
+void print_failure(parse::state& ps) {
+	parse::ind pos = ps.failPos();
+	parse::location loc = ps.locate(pos);
+	parse::state::range_type text = ps.line(pos);
+	
+	//point at the error under the line, keeping its tabs for alignment
+	std::string prefix = "line " + std::to_string(loc.line) + ":   ";
+	std::string pad(prefix.size(), ' ');
+	for (const char* it = text.first; it < ps.buffered(pos).first; ++it) {
+		pad += ( *it == '\t' ) ? '\t' : ' ';
+	}
+	
+	std::cerr << "Parse failure " << pos << " bytes into the input:" << std::endl;
+	std::cerr << prefix << std::string(text.first, text.second) << std::endl;
+	std::cerr << pad << "^-- error, column " << loc.column;
+	
+	std::vector<parse::expectation> es = ps.expected();
+	for (unsigned long i = 0; i < es.size(); ++i) {
+		if ( i == 0 ) std::cerr << ", expected ";
+		else if ( i + 1 == es.size() ) std::cerr << " or ";
+		else std::cerr << ", ";
+		std::cerr << es[i].str();
+	}
+	std::cerr << std::endl;
+}
+
+/** Matches input against a grammar using the interpreter.
+ *  @return The exit code of egg */
+int match_input(ast::grammar& g, args& a, phase_timer& t) {
+	try {
+		visitor::interpreter vm(g);
+		
+		std::unique_ptr<parse::mapped_file> mf;
+		std::unique_ptr<parse::state> ps;
+		bool matched;
+		if ( a.match_file().empty() ) {
+			//feed standard input to the matcher as it arrives
+			ps.reset(new parse::state());
+			visitor::interpreter::machine m(vm, *ps);
+			std::vector<char> buf(parse::state::block_size);
+			while ( m.run() == visitor::match_suspended ) {
+				std::cin.read(buf.data(), buf.size());
+				if ( std::cin.gcount() > 0 ) ps->feed(buf.data(), std::cin.gcount());
+				else ps->finish();
+			}
+			matched = m.status() == visitor::match_succeeded;
+		} else {
+			mf.reset(new parse::mapped_file(a.match_file().c_str()));
+			ps.reset(new parse::state(*mf));
+			matched = vm.match(*ps);
+		}
+		t.end("match");
+		
+		if ( ! matched ) {
+			print_failure(*ps);
+			return 1;
+		}
+		a.output() << "Matched " << ps->pos << " bytes" << std::endl;
+	} catch (std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	
+	return 0;
+}
+
 /** Command line interface
  *  egg [command] [flags] [input-file [output-file]]
  *  
  *  Supported flags are
  *  -i --input    input file (default stdin)
  *  -o --output   output file (default stdout)
- *  -c --command  command - either compile, print, help, usage, or version 
- *                (default compile)
+ *  -c --command  command - either compile, print, match, help, usage, or 
+ *                version (default compile)
+ *  -m --match    file to match against the grammar with the interpreter 
+ *                (sets command to match; default stdin)
  *  -n --name     grammar name - if none given, takes the longest prefix of 
  *                the input or output file name (output preferred) which is a 
  *                valid Egg identifier (default empty)
  *  --no-norm     turns off grammar normalization
+ *  --no-opt      turns off grammar optimization
+ *  --memo        memoize the results of all rules (packrat parsing)
+ *  --flat        generate flat code using gotos rather than nested lambdas
+ *  --parallel    generate a parse_parallel() driver, which matches the 
+ *                records of a file with the first rule on multiple threads
+ *  --profile     record the calls, failures and time of each rule, printed 
+ *                by the generated dump_profile()
+ *  --sax         generate untyped rules without semantic actions, which 
+ *                report each rule matched to a handler
+ *  --cst         record each rule matched as a node of the concrete syntax 
+ *                tree of the parser state
+ *  --stats       count input, backtracking and memo use in the parser 
+ *                state, printed by the generated dump_stats()
+ *  --inline N    splice untyped, non-recursive rules of at most N matchers 
+ *                into their callers (default 16; 0 for none)
+ *  --state TYPE  type of parser state the generated rules take, e.g. 
+ *                parse::unchecked_state (default parse::state)
+ *  --time-phases print the time taken by each phase of egg to stderr
  *  --usage       print usage message
  *  --help        print full help message
  *  --version     print version string
@@ -238,44 +452,90 @@ int main(int argc, char** argv) {
 	default: break;
 	}
 
-	parse::state ps(a.input());
-	ast::grammar_ptr g;
+	phase_timer t(a.time_phases());
+	
+	//allocate the AST from an arena, freed in one shot on exit
+	parse::arena nodes;
+	ast::arena_scope scope(nodes);
+	
+	//read an input file in place, rather than through a stream
+	std::unique_ptr<parse::mapped_file> mf;
+	std::unique_ptr<parse::state> in;
+	try {
+		if ( a.input_file().empty() ) {
+			in.reset(new parse::state(std::cin));
+		} else {
+			mf.reset(new parse::mapped_file(a.input_file().c_str()));
+			in.reset(new parse::state(*mf));
+		}
+	} catch (std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	parse::state& ps = *in;
+	ast::grammar_ptr g = 0;
 	
 	if ( egg::grammar(ps)(g) ) {
-		//std::cout << "DONE PARSING" << std::endl;
+		t.end("parse");
 		if ( a.norm() ) {
 			visitor::normalizer n;
 			n.normalize(*g);
+			t.end("normalize");
+		}
+		if ( a.opt() ) {
+			visitor::optimizer o;
+			o.optimize(*g);
+			t.end("optimize");
 		}
 
 		switch ( a.mode() ) {
 		case PRINT_MODE: {
 			visitor::printer p(a.output());
 			p.print(*g);
+			a.output().flush();
+			t.end("print");
 			break;
+		} case MATCH_MODE: {
+			return match_input(*g, a, t);
 		} case COMPILE_MODE: {
-			visitor::compiler c(a.name(), a.output());
+			visitor::compiler_options opts;
+			opts.memo = a.memo();
+			opts.flat = a.flat();
+			opts.parallel = a.parallel();
+			opts.profile = a.profile();
+			opts.sax = a.sax();
+			if ( opts.sax && opts.profile ) {
+				std::cerr << "Warning: --profile is ignored with --sax" << std::endl;
+			}
+			if ( opts.sax && opts.parallel ) {
+				std::cerr << "Warning: --parallel is ignored with --sax" << std::endl;
+			}
+			opts.cst = a.cst();
+			if ( opts.sax && opts.cst ) {
+				std::cerr << "Warning: --cst is ignored with --sax" << std::endl;
+			} else if ( opts.cst && opts.profile ) {
+				std::cerr << "Warning: --profile is ignored with --cst" << std::endl;
+			}
+			if ( opts.cst && ! opts.sax && opts.parallel ) {
+				std::cerr << "Warning: --parallel is ignored with --cst" << std::endl;
+			}
+			opts.stats = a.stats();
+			opts.inline_size = a.inline_size();
+			opts.state = a.state_type();
+			if ( opts.parallel && opts.state != "parse::state" && ! opts.sax && ! opts.cst ) {
+				std::cerr << "Warning: --parallel is ignored with --state" << std::endl;
+			}
+			visitor::compiler c(a.name(), a.output(), opts);
 			c.compile(*g);
+			a.output().flush();
+			t.end("compile");
 			break;
 		}
 		default: break;
 		}
 		
 	} else {
-		int64_t maxPos=ps.maxRead();
-		int64_t startPos; for (startPos=maxPos-1;startPos>0&&ps[startPos]!='\n';--startPos); startPos+=ps[startPos]=='\n';
-		int64_t endPos; for (endPos=maxPos;ps[endPos]!='\n'&&ps[endPos]!='\0';++endPos);
-		int64_t lineCount=1;
-		try {
-			for(int64_t pos=startPos;pos>0;--pos) lineCount+=(ps[pos]=='\n');
-		} catch(parse::forgotten_state_error& e) {
-			lineCount += e.newlines;
-		}
-		int64_t errPos=maxPos-startPos;
-
-		std::cerr << "Parse failure " << maxPos << " bytes into the input:" << std::endl;
-		std::cerr << "line " << lineCount << ":   " << ps.string(startPos,endPos-startPos) << std::endl;
-		std::cerr << std::string(5+ceil(log10(lineCount)+4),' ') << std::string(maxPos-startPos-1, ' ') << "^-- error, column " << errPos << std::endl;
+		print_failure(ps);
 		return 1;
 	}
 
@@ -22,12 +22,50 @@
  * THE SOFTWARE.
  */
 
-#include <deque>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iomanip>
 #include <istream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <type_traits>
 #include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PARSE_MMAP 1
+#endif
+
+#if defined(__GNUC__) && ( defined(__SSE4_1__) || defined(__AVX2__) )
+#include <immintrin.h>
+#define PARSE_SIMD 1
+#endif
+
+// Define PARSE_STATS before including this header (in every translation 
+// unit, as it changes parse::state) to count the work of each parser state 
+// in its stats member; see parse::state_stats. `egg --stats` defines it.
+#ifdef PARSE_STATS
+#define PARSE_STATE_STATS 1
+#endif
 
 /** Implements parser state for an Egg parser.
  *  
@@ -46,20 +84,9 @@ namespace parse {
 		 *  @param req		Requested index
 		 *  @param avail	Minimum available index
 		 */
-		forgotten_state_error(ind req, ind avail,ind newlines) throw()
-			: std::range_error("Forgotten state error"), 
-			req(req), avail(avail), newlines(0) {}
-		
-		/** Inherited from std::exception. */
-		const char* what() const throw() {
-			try {
-				std::stringstream ss("Forgotten state error");
-				ss << ": requested " << req << " < " << avail << " < " << newlines;
-				return ss.str().c_str();
-			} catch (std::exception const& e) {
-				return "Forgotten state error";
-			}
-		}
+		forgotten_state_error(ind req, ind avail, ind newlines)
+			: std::range_error(message(req, avail)), 
+			req(req), avail(avail), newlines(newlines) {}
 		
 		/** requested index */
 		ind req;
@@ -67,22 +94,822 @@ namespace parse {
 		ind avail;
 		/** number of newlines forgotten so far */
 		ind newlines;
+		
+	private:
+		static std::string message(ind req, ind avail) {
+			std::stringstream ss;
+			ss << "Forgotten state error: requested " << req << " < " << avail;
+			return ss.str();
+		}
 	}; /* struct forgotten_range_error */
 	
+	/** Read-only view of the contents of a file, for use as in-memory parser 
+	 *  input. Memory-maps the file where supported, reading it into memory 
+	 *  otherwise. */
+	class mapped_file {
+	public:
+		/** Maps the given file.
+		 *  @param path		Path of the file to map
+		 *  @throws std::runtime_error if the file cannot be read
+		 */
+		mapped_file(const char* path) : buf(0), len(0), mapped(false) {
+#ifdef PARSE_MMAP
+			int fd = ::open(path, O_RDONLY);
+			if ( fd < 0 ) throw std::runtime_error(std::string("Cannot open ") + path);
+			
+			struct stat st;
+			if ( ::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) ) {
+				len = st.st_size;
+				if ( len == 0 ) { ::close(fd); return; }
+				
+				void* p = ::mmap(0, len, PROT_READ, MAP_PRIVATE, fd, 0);
+				if ( p != MAP_FAILED ) {
+					::close(fd);
+					buf = static_cast<const char*>(p);
+					mapped = true;
+					::madvise(p, len, MADV_SEQUENTIAL);
+					return;
+				}
+			}
+			::close(fd);
+#endif
+			// Fall back to reading the file
+			std::ifstream in(path, std::ios::in | std::ios::binary);
+			if ( ! in ) throw std::runtime_error(std::string("Cannot open ") + path);
+			copy.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+			buf = copy.data();
+			len = copy.size();
+		}
+		
+		~mapped_file() {
+#ifdef PARSE_MMAP
+			if ( mapped ) ::munmap(const_cast<char*>(buf), len);
+#endif
+		}
+		
+		/** Start of the file contents */
+		const char* data() const { return buf; }
+		
+		/** Length of the file contents */
+		ind size() const { return len; }
+		
+		/** Hints that the first n bytes of the file will not be needed again, 
+		 *  allowing the operating system to drop them from memory. */
+		void release(ind n) const {
+#ifdef PARSE_MMAP
+			if ( ! mapped ) return;
+			ind page = ::sysconf(_SC_PAGESIZE);
+			n -= n % page;
+			if ( n > 0 ) ::madvise(const_cast<char*>(buf), n, MADV_DONTNEED);
+#endif
+		}
+		
+	private:
+		mapped_file(const mapped_file&);
+		mapped_file& operator= (const mapped_file&);
+		
+		const char* buf;		/**< file contents */
+		ind len;				/**< length of file contents */
+		bool mapped;			/**< is buf memory-mapped? */
+		std::vector<char> copy;	/**< file contents, if not memory-mapped */
+	}; /* class mapped_file */
+	
+	/** Read-only view of a range of parser input, which refers to the 
+	 *  input in place rather than copying it. A span is only valid until the 
+	 *  state it was taken from next reads input or forgets the range, and 
+	 *  should be converted to a std::string to be kept longer. */
+	class span {
+	public:
+		typedef char			value_type;
+		typedef const char*		iterator;
+		typedef ind				size_type;
+		
+		/** Empty span */
+		span() : b(0), n(0) {}
+		
+		/** Span of the n characters starting at b */
+		span(const char* b, size_type n) : b(b), n(n) {}
+		
+		const char* data() const { return b; }
+		size_type size() const { return n; }
+		size_type length() const { return n; }
+		bool empty() const { return n == 0; }
+		
+		iterator begin() const { return b; }
+		iterator end() const { return b + n; }
+		
+		value_type operator[] (size_type i) const { return b[i]; }
+		
+		/** Copies the spanned characters into a new string */
+		std::string str() const { return std::string(b, n); }
+		
+		/** Implicit conversion to string (copies the spanned characters) */
+		operator std::string () const { return str(); }
+		
+		bool operator== (const span& o) const {
+			return n == o.n && std::memcmp(b, o.b, n) == 0;
+		}
+		bool operator!= (const span& o) const { return !(*this == o); }
+		
+		bool operator== (const std::string& s) const {
+			return n == s.size() && std::memcmp(b, s.data(), n) == 0;
+		}
+		bool operator!= (const std::string& s) const { return !(*this == s); }
+		
+		bool operator== (const char* s) const {
+			return std::strlen(s) == n && std::memcmp(b, s, n) == 0;
+		}
+		bool operator!= (const char* s) const { return !(*this == s); }
+		
+	private:
+		const char* b;	/**< start of the spanned characters */
+		size_type n;	/**< number of spanned characters */
+	}; /* class span */
+	
+	inline std::ostream& operator<< (std::ostream& out, const span& s) {
+		return out.write(s.data(), s.size());
+	}
+	
+	/** A set of characters, stored as a 256-bit table indexed by the 
+	 *  (unsigned) character value. */
+	struct char_set {
+		/** Is the character in the set? */
+		constexpr bool contains(char c) const {
+			return ( bits[(unsigned char)c >> 6] >> ((unsigned char)c & 63) ) & 1;
+		}
+		
+		unsigned long long bits[4];	/**< Membership bits, 64 characters per word */
+	}; /* struct char_set */
+
+	/** A range of Unicode codepoints, from from to to inclusive */
+	struct code_range {
+		char32_t from;	/**< The first codepoint in the range */
+		char32_t to;	/**< The last codepoint in the range */
+	}; /* struct code_range */
+
+	/** A set of non-ASCII Unicode codepoints, stored as a sorted table of
+	 *  disjoint ranges. A Unicode character class is matched by a char_set
+	 *  of its ASCII members, which are matched without decoding, and a
+	 *  code_set of the rest. */
+	struct code_set {
+		/** Is the codepoint in the set? Binary searches the ranges. */
+		bool contains(char32_t c) const {
+			ind lo = 0, hi = n;
+			while ( lo < hi ) {
+				ind mid = lo + (hi - lo) / 2;
+				if ( rs[mid].to < c ) lo = mid + 1;
+				else hi = mid;
+			}
+			return lo < n && rs[lo].from <= c;
+		}
+
+		const code_range* rs;	/**< The ranges, in increasing order */
+		ind n;					/**< The number of ranges */
+		const char* name;		/**< The class, as written, for expectations */
+	}; /* struct code_set */
+
+	/** Gets the number of characters in the UTF-8 sequence beginning with
+	 *  c, or 0 if c cannot begin one (that is, is a continuation byte, or
+	 *  never occurs in UTF-8) */
+	inline ind utf8_length(char c) {
+		// indexed by the top five bits of the first byte
+		static const unsigned char lengths[32] = {
+			1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+			0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 3, 3, 4, 0 };
+		return lengths[(unsigned char)c >> 3];
+	}
+
+	/** Decodes the UTF-8 sequence of n characters starting at s, where n is
+	 *  utf8_length(s[0]) (and not 0).
+	 *  @param c		Set to the decoded codepoint
+	 *  @return false if the sequence is not valid UTF-8 (a bad continuation
+	 *          byte, an overlong encoding, a surrogate, or a codepoint past
+	 *          U+10FFFF) */
+	inline bool decode_utf8(const char* s, ind n, char32_t& c) {
+		const unsigned char* u = (const unsigned char*)s;
+		switch ( n ) {
+		case 1: 
+			c = u[0];
+			return true;
+		case 2: 
+			c = ( char32_t(u[0] & 0x1f) << 6 ) | ( u[1] & 0x3f );
+			return ( u[1] & 0xc0 ) == 0x80 && c >= 0x80;
+		case 3: 
+			c = ( char32_t(u[0] & 0x0f) << 12 ) | ( char32_t(u[1] & 0x3f) << 6 ) | ( u[2] & 0x3f );
+			return ( ( u[1] & u[2] ) & 0xc0 ) == 0x80 && ( ( u[1] | u[2] ) & 0x40 ) == 0 
+				&& c >= 0x800 && ( c < 0xd800 || c > 0xdfff );
+		case 4: 
+			c = ( char32_t(u[0] & 0x07) << 18 ) | ( char32_t(u[1] & 0x3f) << 12 ) 
+				| ( char32_t(u[2] & 0x3f) << 6 ) | ( u[3] & 0x3f );
+			return ( ( u[1] & u[2] & u[3] ) & 0xc0 ) == 0x80 && ( ( u[1] | u[2] | u[3] ) & 0x40 ) == 0 
+				&& c >= 0x10000 && c <= 0x10ffff;
+		default: 
+			return false;
+		}
+	}
+
+	/** A terminal which a parser expected to match at the furthest position 
+	 *  it failed at, for error messages. Refers to the characters of the 
+	 *  terminal in place, so they must outlive it (as the string literals 
+	 *  and character class tables of generated parsers do). */
+	struct expectation {
+		/** Kinds of terminal */
+		enum kind_type { char_kind, str_kind, set_kind, any_kind, named_kind };
+		
+		/** Expects the character c */
+		static expectation character(char c) { 
+			return expectation(char_kind, c, 0, 0, 0);
+		}
+		
+		/** Expects the n characters starting at s */
+		static expectation string(const char* s, ind n) { 
+			return expectation(str_kind, '\0', s, n, 0);
+		}
+		
+		/** Expects a character in the set s */
+		static expectation set(const char_set& s) { 
+			return expectation(set_kind, '\0', 0, 0, &s);
+		}
+		
+		/** Expects any character (that is, not the end of input) */
+		static expectation any() { 
+			return expectation(any_kind, '\0', 0, 0, 0);
+		}
+		
+		/** Expects a terminal described by the null-terminated string s */
+		static expectation named(const char* s) { 
+			return expectation(named_kind, '\0', s, 0, 0);
+		}
+		
+		bool operator== (const expectation& o) const {
+			return kind == o.kind && c == o.c && n == o.n 
+				&& ( s == o.s || ( kind == named_kind ? std::strcmp(s, o.s) 
+				                                      : std::memcmp(s, o.s, n) ) == 0 )
+				&& ( chars == o.chars || std::memcmp(chars->bits, o.chars->bits, sizeof(chars->bits)) == 0 );
+		}
+		bool operator!= (const expectation& o) const { return !(*this == o); }
+		
+		/** Is this the same terminal as o, with the same characters (rather 
+		 *  than just equal ones)? */
+		bool same(const expectation& o) const {
+			return kind == o.kind && c == o.c && s == o.s && chars == o.chars;
+		}
+		
+		/** Describes the terminal, e.g. 'a', "abc", [a-z], or any character */
+		std::string str() const {
+			switch ( kind ) {
+			case char_kind:  return "'" + escape(c, '\'') + "'";
+			case str_kind: {
+				std::string r = "\"";
+				for (ind i = 0; i < n; ++i) r += escape(s[i], '\"');
+				return r + "\"";
+			} case set_kind:  return describe(*chars);
+			case any_kind:   return "any character";
+			case named_kind: return std::string(s);
+			}
+			return "";
+		}
+		
+		/** Describes a set of characters as a character class (or a single 
+		 *  character, if it has only one member) */
+		static std::string describe(const char_set& cs) {
+			int count = 0, last = 0;
+			for (int c = 0; c < 256; ++c) {
+				if ( cs.contains(char(c)) ) { ++count; last = c; }
+			}
+			if ( count == 1 ) return "'" + escape(char(last), '\'') + "'";
+			
+			// list the smaller of the set and its complement (which, like a 
+			// negated class, excludes the end-of-input '\0')
+			bool neg = count > 128;
+			if ( count == 255 && ! cs.contains('\0') ) return "any character";
+			std::string r = neg ? "[^" : "[";
+			for (int c = neg ? 1 : 0; c < 256; ++c) {
+				if ( cs.contains(char(c)) == neg ) continue;
+				int e = c;
+				while ( e + 1 < 256 && cs.contains(char(e + 1)) != neg ) ++e;
+				r += escape(char(c), ']');
+				if ( e > c + 1 ) r += "-";
+				if ( e > c ) r += escape(char(e), ']');
+				c = e;
+			}
+			return r + "]";
+		}
+		
+		kind_type kind;		/**< kind of the terminal */
+		char c;				/**< expected character, for char_kind */
+		const char* s;		/**< expected string, for str_kind, or description, 
+		              		 *   for named_kind */
+		ind n;				/**< length of s, for str_kind */
+		const char_set* chars;	/**< expected characters, for set_kind */
+		
+		/** Placeholder expecting any character */
+		expectation() : kind(any_kind), c('\0'), s(0), n(0), chars(0) {}
+		
+	private:
+		expectation(kind_type kind, char c, const char* s, ind n, const char_set* cs)
+			: kind(kind), c(c), s(s), n(n), chars(cs) {}
+		
+		/** Escapes a character for display, including the given quote */
+		static std::string escape(char c, char quote) {
+			switch ( c ) {
+			case '\n':  return "\\n";
+			case '\r':  return "\\r";
+			case '\t':  return "\\t";
+			case '\\': return "\\\\";
+			default: break;
+			}
+			if ( c == quote ) return std::string("\\") + c;
+			if ( c >= ' ' && c <= '~' ) return std::string(1, c);
+			
+			const char* hex = "0123456789abcdef";
+			unsigned char u = c;
+			return std::string("\\x") + hex[u >> 4] + hex[u & 0xf];
+		}
+	}; /* struct expectation */
+	
+	/** A position in the input, as a line and column (in characters), both 
+	 *  counted from 1. */
+	struct location {
+		location(ind line, ind column) : line(line), column(column) {}
+		
+		ind line;	/**< line number */
+		ind column;	/**< column number */
+	}; /* struct location */
+	
+	/** Bump allocator which owns the objects allocated from it, and frees 
+	 *  them all at once on clear() or destruction. Objects are allocated in 
+	 *  large blocks, and never freed individually; destructors of objects 
+	 *  which have them are run (in reverse order of allocation) when the 
+	 *  arena is cleared. Suitable for building parse trees from semantic 
+	 *  actions. */
+	class arena {
+	public:
+		/** Minimum size of an allocated block */
+		static const std::size_t block_size = 64*1024;
+		
+		arena() : blocks(0), spare(0), next(0), left(0), dtors(0), used(0) {}
+		
+		arena(arena&& o) 
+			: blocks(o.blocks), spare(o.spare), next(o.next), left(o.left), 
+			  dtors(o.dtors), used(o.used) { o.release(); o.spare = 0; }
+		
+		arena& operator= (arena&& o) {
+			if ( this != &o ) {
+				clear();
+				blocks = o.blocks; spare = o.spare; next = o.next; left = o.left;
+				dtors = o.dtors; used = o.used;
+				o.release();
+				o.spare = 0;
+			}
+			return *this;
+		}
+		
+		~arena() { clear(); }
+		
+		/** Allocates uninitialized memory, which is freed with the arena.
+		 *  @param n		The number of bytes to allocate
+		 *  @param align	The alignment of the allocation (a power of two)
+		 */
+		void* allocate(std::size_t n, std::size_t align = alignof(std::max_align_t)) {
+			std::size_t pad = -reinterpret_cast<std::uintptr_t>(next) & (align - 1);
+			if ( n + pad > left ) {
+				grow(n + align);
+				pad = -reinterpret_cast<std::uintptr_t>(next) & (align - 1);
+			}
+			char* p = next + pad;
+			next = p + n;
+			left -= n + pad;
+			used += n;
+			return p;
+		}
+		
+		/** Constructs an object in the arena; it will be destroyed when the 
+		 *  arena is cleared.
+		 *  @param T		The type of object to make
+		 *  @param args		Arguments to T's constructor
+		 */
+		template<typename T, typename... Args>
+		T* make(Args&&... args) {
+			T* t = new(allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+			if ( ! std::is_trivially_destructible<T>::value ) {
+				dtor* d = new(allocate(sizeof(dtor), alignof(dtor))) dtor;
+				d->f = &destroy<T>;
+				d->p = t;
+				d->next = dtors;
+				dtors = d;
+			}
+			return t;
+		}
+		
+		/** Destroys all the objects in the arena, and frees its memory */
+		void clear() {
+			reset();
+			while ( spare ) {
+				block* b = spare;
+				spare = b->next;
+				::operator delete(b);
+			}
+		}
+		
+		/** Destroys all the objects in the arena, keeping its memory to 
+		 *  allocate from again, so an arena reset between uses of similar 
+		 *  size stops allocating once it has grown to fit them */
+		void reset() {
+			for (dtor* d = dtors; d; d = d->next) d->f(d->p);
+			while ( blocks ) {
+				block* b = blocks;
+				blocks = b->next;
+				b->next = spare;
+				spare = b;
+			}
+			release();
+		}
+		
+		/** Number of bytes allocated from the arena */
+		std::size_t size() const { return used; }
+		
+	private:
+		arena(const arena&);
+		arena& operator= (const arena&);
+		
+		/** Header of an allocated block; the block memory follows */
+		struct block {
+			block* next;		/**< previously allocated block */
+			std::size_t len;	/**< bytes of block memory */
+		};
+		
+		/** Destructor to run on clear */
+		struct dtor {
+			void (*f)(void*);	/**< destroys p */
+			void* p;			/**< object to destroy */
+			dtor* next;			/**< destructor to run after this one */
+		};
+		
+		template<typename T>
+		static void destroy(void* p) { static_cast<T*>(p)->~T(); }
+		
+		/** Starts a new block with at least n bytes free, reusing a spare 
+		 *  block if one is large enough */
+		void grow(std::size_t n) {
+			block** s = &spare;
+			while ( *s && (*s)->len < n ) s = &(*s)->next;
+			block* b = *s;
+			if ( b ) {
+				*s = b->next;
+			} else {
+				std::size_t len = std::max(n, block_size - sizeof(block));
+				b = static_cast<block*>(::operator new(sizeof(block) + len));
+				b->len = len;
+			}
+			b->next = blocks;
+			blocks = b;
+			next = reinterpret_cast<char*>(b + 1);
+			left = b->len;
+		}
+		
+		/** Forgets the arena contents (but not the spare blocks), without 
+		 *  freeing them */
+		void release() { blocks = 0; next = 0; left = 0; dtors = 0; used = 0; }
+		
+		block* blocks;		/**< allocated blocks, newest first */
+		block* spare;		/**< blocks freed by reset(), to reuse */
+		char* next;			/**< next free byte of the current block */
+		std::size_t left;	/**< free bytes in the current block */
+		dtor* dtors;		/**< destructors to run, newest first */
+		std::size_t used;	/**< bytes allocated */
+	}; /* class arena */
+	
+	/** Node of a concrete syntax tree; one successful match of a rule */
+	struct cst_node {
+		/** Index of no node */
+		static const ind none = ~ind(0);
+		
+		ind rule;	/**< Identifier of the rule matched */
+		ind start;	/**< Input index the match started at */
+		ind len;	/**< Number of characters matched */
+		ind child;	/**< Index of the first child node, or none */
+		ind next;	/**< Index of the next sibling node, or none */
+	}; /* struct cst_node */
+	
+	/** Concrete syntax tree built by a parser generated with `egg --cst`,
+	 *  as a flat array of nodes in pre-order, so each node is followed by
+	 *  the nodes of its subtree. The nodes of a rule being matched are
+	 *  appended as its subrules match, and backtracking unwinds them by
+	 *  truncating the array to the size it had before; a node's next
+	 *  sibling is not known until its parent matches, so next holds the
+	 *  index past the node's subtree until then. */
+	class cst_tree {
+	public:
+		typedef std::vector<cst_node>::const_iterator	iterator;
+		
+		cst_tree() : ns(), depth(0) {}
+		
+		/** Gets the i'th node; the first node matched by the outermost rule
+		 *  called is the root, at index 0 */
+		const cst_node& operator[] (ind i) const { return ns[i]; }
+		
+		/** Number of nodes in the tree */
+		ind size() const { return ns.size(); }
+		
+		bool empty() const { return ns.empty(); }
+		
+		iterator begin() const { return ns.begin(); }
+		iterator end() const { return ns.end(); }
+		
+		/** Removes all the nodes, keeping their memory to reuse */
+		void clear() { ns.clear(); depth = 0; }
+		
+		/** Removes the nodes added since the tree had n nodes, on
+		 *  backtracking */
+		void unwind(ind n) { ns.erase(ns.begin() + n, ns.end()); }
+		
+		/** Starts the node of a rule matched at pos.
+		 *  @return The index of the node, to pass to exit() or fail() */
+		ind enter(ind rule, ind pos) {
+			ns.push_back(cst_node{rule, pos, 0, cst_node::none, cst_node::none});
+			++depth;
+			return ns.size() - 1;
+		}
+		
+		/** Completes node n, the rule of which has matched up to pos,
+		 *  linking the nodes its subrules matched as its children */
+		void exit(ind n, ind pos) {
+			ind e = ns.size();
+			if ( n + 1 < e ) {
+				ns[n].child = n + 1;
+				ind c = n + 1;
+				while ( ns[c].next != e ) c = ns[c].next;
+				ns[c].next = cst_node::none;
+			}
+			ns[n].len = pos - ns[n].start;
+			// the next sibling of a node (if any) starts after its subtree
+			ns[n].next = --depth > 0 ? e : cst_node::none;
+		}
+		
+		/** Removes node n, the rule of which has failed to match */
+		void fail(ind n) {
+			unwind(n);
+			--depth;
+		}
+		
+		/** Appends copies of the nodes from index n on to v, relative to
+		 *  input index i and to n, for a memoized result */
+		void save(ind n, ind i, std::vector<cst_node>& v) const {
+			v.clear();
+			for (ind j = n; j < ns.size(); ++j) {
+				cst_node x = ns[j];
+				x.start -= i;
+				if ( x.child != cst_node::none ) x.child -= n;
+				if ( x.next != cst_node::none ) x.next -= n;
+				v.push_back(x);
+			}
+		}
+		
+		/** Appends the nodes saved by save(), matched again at input
+		 *  index i */
+		void restore(const std::vector<cst_node>& v, ind i) {
+			ind n = ns.size();
+			for (auto it = v.begin(); it != v.end(); ++it) {
+				cst_node x = *it;
+				x.start += i;
+				if ( x.child != cst_node::none ) x.child += n;
+				if ( x.next != cst_node::none ) x.next += n;
+				ns.push_back(x);
+			}
+		}
+	
+	private:
+		std::vector<cst_node> ns;	/**< Nodes, in pre-order */
+		ind depth;					/**< Number of nodes not yet completed */
+	}; /* class cst_tree */
+	
+	/** Counters of the work done by a parser state, kept in state::stats 
+	 *  if PARSE_STATS is defined, for finding whether a slow parse is 
+	 *  spent in input, backtracking, or the structure of the grammar. 
+	 *  Rule resets are only counted by parsers generated with 
+	 *  `egg --stats`. */
+	struct state_stats {
+		state_stats() 
+			: chars(0), reads(0), max_window(0), examined(0), resets(0), 
+			  backtracked(0), memo_hits(0), memo_misses(0), rule_resets() {}
+		
+		/** Counts a rule returning the input position n characters back 
+		 *  to the start of a matcher (psStart), after a failed match or a 
+		 *  lookahead */
+		void backtrack(ind rule, ind n) {
+			if ( n == 0 ) return;
+			++resets;
+			backtracked += n;
+			if ( rule >= rule_resets.size() ) rule_resets.resize(rule + 1, 0);
+			++rule_resets[rule];
+		}
+		
+		ind chars;			/**< Characters of input read, fed, or given in 
+		          			 *   memory */
+		ind reads;			/**< Calls to read more input from a stream */
+		ind max_window;		/**< Most characters of input buffered at once, 
+		               		 *   between cuts */
+		ind examined;		/**< Characters examined by the matchers, 
+		             		 *   counting each time one is examined again 
+		             		 *   after backtracking */
+		ind resets;			/**< Times the position was moved back */
+		ind backtracked;	/**< Characters the position was moved back over */
+		ind memo_hits;		/**< Memoized results recalled */
+		ind memo_misses;	/**< Memoized results looked up but not found */
+		std::vector<ind> rule_resets;	/**< Resets by rule identifier */
+	}; /* struct state_stats */
+
+	template<typename T> class result;
+	
+	/** Untyped base of a memoized rule result. */
+	class memo_entry {
+	public:
+		memo_entry(ind end, ind reach) : end(end), reach(reach) {}
+		virtual ~memo_entry() {}
+		
+		ind end;	/**< input index following the memoized match */
+		ind reach;	/**< one past the maximum input index examined by the match */
+	}; /* class memo_entry */
+	
+	/** Memoized rule result of type T. */
+	template<typename T>
+	class typed_memo_entry : public memo_entry {
+	public:
+		typed_memo_entry(const result<T>& r, ind end, ind reach) 
+			: memo_entry(end, reach), r(r) {}
+		
+		result<T> r;	/**< the memoized result */
+	}; /* class typed_memo_entry<T> */
+	
+	/** Memoized rule result of type T, with the syntax tree nodes matched by 
+	 *  the rule's subrules (as saved by cst_tree::save()). */
+	template<typename T>
+	class tree_memo_entry : public typed_memo_entry<T> {
+	public:
+		tree_memo_entry(const result<T>& r, ind end, ind reach) 
+			: typed_memo_entry<T>(r, end, reach), nodes() {}
+		
+		std::vector<cst_node> nodes;	/**< the memoized subtree */
+	}; /* class tree_memo_entry<T> */
+	
 	/** Parser state */
 	class state {
 	public:
 		typedef char								value_type;
-		typedef std::deque<char>::iterator			iterator;
+		typedef const char*							iterator;
 		typedef std::pair<iterator, iterator>		range_type;
-		typedef std::deque<char>::difference_type	difference_type;
+		typedef std::ptrdiff_t						difference_type;
 		typedef ind								size_type;
 		
-		/** Default constructor.
+		/** Minimum size of the input buffer; the buffer size is always a 
+		 *  power of two multiple of this. */
+		static const size_type block_size = 4096;
+		
+		/** Maximum number of terminals recorded as expected at the furthest 
+		 *  failure position */
+		static const size_type max_expected = 16;
+		
+		/** Push-mode constructor.
+		 *  Initializes state at the beginning of input which is passed to 
+		 *  feed() as it becomes available, rather than read by the state, 
+		 *  until finish() is called. See feed().
+		 */
+		state()
+			: pos(0), str(), pad(), buf(0), str_lo(0), str_hi(0), str_off(0), str_max(0), 
+			  newlines_off(0), line_pos(0), line_num(0), line_start(0), line_off(0), 
+			  fail_pos(0), n_fails(0), quiet(0), in(0), file(0), pushing(true), 
+			  memos() {}
+		
+		/** Stream constructor.
 		 *  Initializes state at beginning of input stream.
 		 *  @param in		The input stream to read from
 		 */
-		state(std::istream& in) : pos(0), str(), str_off(0), in(in) {}
+		state(std::istream& in) 
+			: pos(0), str(), pad(), buf(0), str_lo(0), str_hi(0), str_off(0), str_max(0), 
+			  newlines_off(0), line_pos(0), line_num(0), line_start(0), line_off(0), 
+			  fail_pos(0), n_fails(0), quiet(0), in(&in), file(0), pushing(false), 
+			  memos() {}
+		
+		/** In-memory constructor.
+		 *  Initializes state at beginning of the given characters, which are 
+		 *  not copied, and must remain valid for the lifetime of the state.
+		 *  @param data		The input characters
+		 *  @param len		The number of input characters
+		 */
+		state(const char* data, size_type len)
+			: pos(0), str(), pad(), buf(data), str_lo(0), str_hi(len), str_off(0), str_max(0), 
+			  newlines_off(0), line_pos(0), line_num(0), line_start(0), line_off(0), 
+			  fail_pos(0), n_fails(0), quiet(0), in(0), file(0), pushing(false), 
+			  memos() { count_input(len); }
+		
+		/** Mapped file constructor.
+		 *  Initializes state at beginning of the given file, which must remain 
+		 *  mapped for the lifetime of the state. Forgotten input is released 
+		 *  back to the operating system.
+		 *  @param f		The input file
+		 */
+		state(const mapped_file& f)
+			: pos(0), str(), pad(), buf(f.data()), str_lo(0), str_hi(f.size()), str_off(0), 
+			  str_max(0), newlines_off(0), line_pos(0), line_num(0), line_start(0), 
+			  line_off(0), fail_pos(0), n_fails(0), quiet(0), in(0), file(&f), 
+			  pushing(false), memos() { count_input(f.size()); }
+		
+		/** Resets the state to the beginning of the given input stream, as 
+		 *  if newly constructed, but keeping the input buffer and the memory 
+		 *  of the arena to reuse, so that a state reset for each of a series 
+		 *  of inputs stops allocating once it has grown to fit them. 
+		 *  Invalidates iterators and spans into the input, and the objects 
+		 *  in the arena.
+		 *  @param in		The input stream to read from
+		 */
+		void reset(std::istream& in) {
+			restart();
+			buf = str.data();
+			this->in = &in;
+		}
+		
+		/** Resets the state to the beginning of the given in-memory input; 
+		 *  see reset(std::istream&).
+		 *  @param data		The input characters
+		 *  @param len		The number of input characters
+		 */
+		void reset(const char* data, size_type len) {
+			restart();
+			buf = data;
+			str_hi = len;
+			count_input(len);
+		}
+		
+		/** Resets the state to the beginning of the given mapped file; see 
+		 *  reset(std::istream&).
+		 *  @param f		The input file
+		 */
+		void reset(const mapped_file& f) {
+			restart();
+			buf = f.data();
+			str_hi = f.size();
+			file = &f;
+			count_input(f.size());
+		}
+		
+		/** Resets the state to the beginning of push-mode input, to be 
+		 *  passed to feed(); see reset(std::istream&) */
+		void reset() {
+			restart();
+			buf = str.data();
+			pushing = true;
+		}
+		
+		/** Appends characters to the input of a push-mode state (one 
+		 *  default-constructed, or reset()), copying them into the input 
+		 *  buffer. Until finish() is called, the state treats the end of the 
+		 *  characters fed so far as the end of the input, but notes when a 
+		 *  matcher reads past it (see waiting() and incomplete()); memoized 
+		 *  results which did so are discarded here, as the input they read 
+		 *  has changed. Invalidates iterators and spans into the input.
+		 *  @param data		The characters to append
+		 *  @param len		The number of characters to append
+		 *  @throws std::logic_error if the state is not in push mode, or 
+		 *  		finish() has been called
+		 */
+		void feed(const char* data, size_type len) {
+			if ( ! pushing ) throw std::logic_error("feed() after finish(), or without push mode");
+			
+			size_type end = str_off + (str_hi - str_lo);
+			reserve(len);
+			if ( len > 0 ) std::memcpy(str.data() + str_hi, data, len);
+			str_hi += len;
+			count_input(len);
+			
+			// Discard memoized results which read past the old end of input
+			if ( str_max > end ) {
+				for (auto it = memos.begin(); it != memos.end();) {
+					if ( it->second->reach > end ) it = memos.erase(it);
+					else ++it;
+				}
+			}
+		}
+		
+		/** Ends the input of a push-mode state; the characters fed so far 
+		 *  are all of the input. */
+		void finish() { pushing = false; }
+		
+		/** Is index i past the end of the input fed to a push-mode state, 
+		 *  which may yet be fed more? Matchers which can suspend (see 
+		 *  visitor::interpreter::machine) wait for such input rather than 
+		 *  reading the end of input there. */
+		bool waiting(size_type i) const {
+			return pushing && i - str_off >= str_hi - str_lo && i >= str_off;
+		}
+		
+		/** Did matching read past the end of the input fed to a push-mode 
+		 *  state, which may yet be fed more? If so, the match (or failure) 
+		 *  may change when more input is fed; a compiled rule should be 
+		 *  matched again after the next feed() or finish(). */
+		bool incomplete() const {
+			return pushing && str_max > str_off + (str_hi - str_lo);
+		}
 		
 		/** Indexing operator.
 		 *  Returns character at specified position in the input stream, 
@@ -94,21 +921,29 @@ namespace parse {
 		 *  		input previously discarded)
 		 */
 		value_type operator[] (size_type i) {
+#ifdef PARSE_STATS
+			++stats.examined;
+#endif
 			
-			// Fail on forgotten index
-			if ( i < str_off ) throw forgotten_state_error(i, str_off, newlines_off);
-			
-			// Get index into stored input
+			// Get index into stored input; forgotten indices wrap around to 
+			// values larger than the stored input, and are caught below
 			ind ii = i - str_off;
 			
-			// Expand stored input if needed
-			if ( ii >= str.size() ) {
-				ind n = 1 + ii - str.size();
-				ind r = read(n);
-				if ( r < n ) return '\0';
+			if ( ii < str_hi - str_lo ) {
+				str_max = std::max(str_max, i + 1);
+				return buf[str_lo + ii];
 			}
 			
-			return str[ii];
+			// Fail on forgotten index
+			if ( i < str_off ) throw forgotten_state_error(i, str_off, newlines_off);
+			str_max = std::max(str_max, i + 1);
+			
+			// Expand stored input
+			ind n = 1 + ii - (str_hi - str_lo);
+			ind r = read(n);
+			if ( r < n ) return '\0';
+			
+			return buf[str_lo + ii];
 		}
 		
 		/** Range operator.
@@ -133,27 +968,79 @@ namespace parse {
 			ind ie = ib + n;
 			
 			// Expand stored input if needed
-			if ( ie > str.size() ) {
-				ind nn = ie - str.size();
-				read(nn);
+			ind len = str_hi - str_lo;
+			if ( ie > len ) {
+				read(ie - len);
+				len = str_hi - str_lo;
 			}
 			
 			// Get iterators, adjusting for the end of the input
-			iterator bIter, eIter;
+			const char* base = buf + str_lo;
+			return range_type(base + std::min(ib, len), base + std::min(ie, len));
+		}
+		
+		/** Window operator.
+		 *  Returns a pointer to the n characters starting at the given 
+		 *  index, reading more input if needed; past the end of the input 
+		 *  the window holds '\0's, so matchers can read all n characters 
+		 *  without checking for the end of the input. The window is usually 
+		 *  the input buffer, and a padded copy of the end of the input 
+		 *  otherwise; it is invalidated by the next call to window() or to 
+		 *  any other non-const method of this class. The characters are not 
+		 *  marked as read; see examined().
+		 *  @param i		The index of the first character of the window
+		 *  @param n		The number of characters in the window
+		 *  @throws forgotten_state_error on i < str_begin (that is, asking for 
+		 *  		input previously discarded)
+		 */
+		const value_type* window(size_type i, size_type n) {
+#ifdef PARSE_STATS
+			stats.examined += n;
+#endif
 			
-			if ( ie >= str.size() ) {
-				eIter = str.end();
-				if ( ib >= str.size() ) {
-					bIter = str.end();
-				} else {
-					bIter = str.begin() + ib;
-				}
-			} else {
-				bIter = str.begin() + ib;
-				eIter = str.begin() + ie;
-			}
+			// Get index into stored input; forgotten indices wrap around to 
+			// values larger than the stored input, and are caught below
+			ind ii = i - str_off;
+			ind len = str_hi - str_lo;
+			if ( ii <= len && n <= len - ii ) return buf + str_lo + ii;
+			
+			// Fail on forgotten index
+			if ( i < str_off ) throw forgotten_state_error(i, str_off, newlines_off);
+			
+			// Expand stored input
+			read(ii + n - len);
+			len = str_hi - str_lo;
+			if ( n <= len - std::min(ii, len) ) return buf + str_lo + ii;
+			
+			// Pad the end of the input
+			pad.assign(n, '\0');
+			if ( ii < len ) std::memcpy(pad.data(), buf + str_lo + ii, len - ii);
+			return pad.data();
+		}
+		
+		/** Marks the input up to (but not including) index i as read, for 
+		 *  matchers which read the input through window() */
+		void examined(size_type i) {
+			str_max = std::max(str_max, i);
+		}
+		
+		/** Buffered range operator.
+		 *  Returns a pair of iterators, begin and end, containing the 
+		 *  characters starting at the given index which have already been 
+		 *  read; no further input is read, so the range may be empty. 
+		 *  Returned iterators are invalidated as for range().
+		 *  @param i		The index of the beginning of the range
+		 *  @throws forgotten_state_error on i < str_begin (that is, asking for 
+		 *  		input previously discarded)
+		 */
+		range_type buffered(size_type i) const {
 			
-			return range_type(bIter, eIter);
+			// Fail on forgotten index
+			if ( i < str_off ) throw forgotten_state_error(i, str_off, newlines_off);
+			
+			const char* base = buf + str_lo;
+			ind len = str_hi - str_lo;
+			return range_type(base + std::min(i - str_off, len), base + len);
 		}
 		
 		/** Substring operator.
@@ -168,6 +1055,19 @@ namespace parse {
 			return std::string(iters.first, iters.second);
 		}
 		
+		/** Span operator.
+		 *  Views the characters in range(i, n) in place, without copying 
+		 *  them. The returned span is invalidated as for range().
+		 *  @param i		The index of the beginning of the range
+		 *  @param n		The maximum number of elements in the range
+		 *  @throws forgotten_state_error on i < str_begin (that is, asking for 
+		 *  		input previously discarded)
+		 */
+		parse::span view(size_type i, size_type n) {
+			range_type iters = range(i, n);
+			return parse::span(iters.first, iters.second - iters.first);
+		}
+		
 		/** Forgets all parsing state before the given index.
 		 *  After this, reads or indexes before the given index will fail with 
 		 *  an exception.
@@ -181,56 +1081,571 @@ namespace parse {
 			// Get index in stored input to forget
 			ind ii = i - str_off;
 			
-			// Count the number of newlines we will forget
-			for ( auto iter = str.begin(), end=str.begin() + ii; iter != end; ++iter ) {
-				newlines_off += ( *iter == '\n' );
+			// Forget past the end of the stored input by reading up to it
+			if ( ii > str_hi - str_lo ) {
+				read(ii - (str_hi - str_lo));
+				if ( ii > str_hi - str_lo ) ii = str_hi - str_lo;
 			}
-
-			// Forget stored input
-			str.erase(str.begin(), str.begin()+ii);
+			str_max = std::max(str_max, str_off + ii);
+			
+			// Count the number of newlines we will forget, continuing the 
+			// line count if it has not passed the forgotten input
+			if ( line_pos > str_off + ii ) restart_lines();
+			count_lines(str_off + ii);
+			newlines_off = line_num;
+			line_off = line_start;
+			
+			// Forget failures before the new start of input
+			if ( fail_pos < str_off + ii ) {
+				fail_pos = str_off + ii;
+				n_fails = 0;
+			}
+			
+			// Forget stored input; the buffer is compacted on the next read 
+			// that needs the space
+			str_lo += ii;
+			if ( file ) file->release(str_lo);
+			
+			// Forget memoized results
+			memos.erase(memos.begin(), memos.lower_bound(memo_key(i, 0)));
 			
 			// Adjust offset
-			str_off = i;
+			str_off += ii;
+		}
+		
+		/** Looks up a memoized rule result at the current position.
+		 *  If one is found, it is stored in r and pos is advanced past the 
+		 *  memoized match.
+		 *  @param id		Identifier of the rule; rule identifiers should be 
+		 *  				unique for all rules run against this state
+		 *  @param r		Result to store the memoized value in
+		 *  @return Was a result memoized for rule id at pos?
+		 */
+		template<typename T>
+		bool recall(ind id, result<T>& r) {
+			auto it = memos.find(memo_key(pos, id));
+#ifdef PARSE_STATS
+			++( it == memos.end() ? stats.memo_misses : stats.memo_hits );
+#endif
+			if ( it == memos.end() ) return false;
+			
+			typed_memo_entry<T>* e = static_cast<typed_memo_entry<T>*>(it->second.get());
+			r = e->r;
+			pos = e->end;
+			str_max = std::max(str_max, e->reach);
+			return true;
+		}
+		
+		/** Starts watching the input examined by a rule matched at the 
+		 *  current position, so that memoize() can record it.
+		 *  @return The previous maximum index requested, to pass to 
+		 *  		memoize() or unwatch() when the rule is done
+		 */
+		size_type watch() {
+			size_type w = str_max;
+			str_max = pos;
+			return w;
+		}
+		
+		/** Stops watching the input examined by a rule, restoring the 
+		 *  maximum index requested to include the input examined before it.
+		 *  @param w		The value returned by watch()
+		 */
+		void unwatch(size_type w) {
+			str_max = std::max(str_max, w);
+		}
+		
+		/** Memoizes the result of a rule matched from i to the current 
+		 *  position, which examined the input up to maxRead(), replacing 
+		 *  any previous result for the same rule and index.
+		 *  @param id		Identifier of the rule
+		 *  @param i		Index the rule was matched at
+		 *  @param r		Result of the rule
+		 *  @return r (the memo table keeps a copy)
+		 */
+		template<typename T>
+		result<T> memoize(ind id, size_type i, result<T> r) {
+			// Reuse the existing entry (of the same rule, so the same type) 
+			// when replacing a result, as seed growing does repeatedly
+			std::unique_ptr<memo_entry>& e = memos[memo_key(i, id)];
+			if ( e ) {
+				typed_memo_entry<T>* te = static_cast<typed_memo_entry<T>*>(e.get());
+				te->r = r;
+				te->end = pos;
+				te->reach = str_max;
+			} else {
+				e.reset(new typed_memo_entry<T>(r, pos, str_max));
+			}
+			return r;
+		}
+		
+		/** Memoizes the result of a watched rule, as above, then stops 
+		 *  watching it.
+		 *  @param id		Identifier of the rule
+		 *  @param i		Index the rule was matched at
+		 *  @param w		The value returned by watch() at i
+		 *  @param r		Result of the rule
+		 *  @return r (the memo table keeps a copy)
+		 */
+		template<typename T>
+		result<T> memoize(ind id, size_type i, size_type w, result<T> r) {
+			r = memoize(id, i, std::move(r));
+			unwatch(w);
+			return r;
+		}
+		
+		/** Looks up a memoized rule result at the current position, as 
+		 *  recall(), also appending the syntax tree nodes matched with it 
+		 *  to tree. Rules memoized this way must be memoized with the 
+		 *  memoize() overloads taking the tree.
+		 *  @param id		Identifier of the rule
+		 *  @param r		Result to store the memoized value in
+		 *  @param t		Syntax tree to add the memoized nodes to
+		 *  @return Was a result memoized for rule id at pos?
+		 */
+		template<typename T>
+		bool recall(ind id, result<T>& r, cst_tree& t) {
+			auto it = memos.find(memo_key(pos, id));
+#ifdef PARSE_STATS
+			++( it == memos.end() ? stats.memo_misses : stats.memo_hits );
+#endif
+			if ( it == memos.end() ) return false;
+			
+			tree_memo_entry<T>* e = static_cast<tree_memo_entry<T>*>(it->second.get());
+			t.restore(e->nodes, pos);
+			r = e->r;
+			pos = e->end;
+			str_max = std::max(str_max, e->reach);
+			return true;
+		}
+		
+		/** Memoizes the result of a rule matched from i to the current 
+		 *  position, as memoize(), with the syntax tree nodes added to t 
+		 *  since it had n nodes (if the rule matched).
+		 *  @param id		Identifier of the rule
+		 *  @param i		Index the rule was matched at
+		 *  @param t		Syntax tree the rule's nodes were added to
+		 *  @param n		Number of nodes in t when the rule started
+		 *  @param r		Result of the rule
+		 *  @return r (the memo table keeps a copy)
+		 */
+		template<typename T>
+		result<T> memoize(ind id, size_type i, const cst_tree& t, ind n, result<T> r) {
+			std::unique_ptr<memo_entry>& e = memos[memo_key(i, id)];
+			if ( ! e ) e.reset(new tree_memo_entry<T>(r, pos, str_max));
+			tree_memo_entry<T>* te = static_cast<tree_memo_entry<T>*>(e.get());
+			te->r = r;
+			te->end = pos;
+			te->reach = str_max;
+			if ( r ) t.save(n, i, te->nodes);
+			else te->nodes.clear();
+			return r;
+		}
+		
+		/** Memoizes the result of a watched rule with its syntax tree 
+		 *  nodes, as above, then stops watching it.
+		 *  @param id		Identifier of the rule
+		 *  @param i		Index the rule was matched at
+		 *  @param w		The value returned by watch() at i
+		 *  @param t		Syntax tree the rule's nodes were added to
+		 *  @param n		Number of nodes in t when the rule started
+		 *  @param r		Result of the rule
+		 *  @return r (the memo table keeps a copy)
+		 */
+		template<typename T>
+		result<T> memoize(ind id, size_type i, size_type w, const cst_tree& t, ind n, 
+				result<T> r) {
+			r = memoize(id, i, t, n, std::move(r));
+			unwatch(w);
+			return r;
+		}
+		
+		/** Edits the input, replacing n characters at index i with the 
+		 *  string s, for incremental reparsing. Memoized results which 
+		 *  examined any of the replaced characters (or, for an insertion, 
+		 *  the characters on both sides of it) are discarded; those after 
+		 *  the edit are moved with their input, so a reparse from the 
+		 *  start recalls them rather than matching them again. The input 
+		 *  is copied into the state on the first edit (reading all of 
+		 *  stream input), and the position is reset to the start. 
+		 *  Invalidates iterators and spans into the input.
+		 *  @param i		The index of the first character to replace
+		 *  @param n		The number of characters to replace
+		 *  @param s		The replacement characters
+		 *  @throws forgotten_state_error if any input has been forgotten
+		 *  @throws std::out_of_range if the edit extends past the end of 
+		 *  		the input
+		 */
+		void edit(size_type i, size_type n, const std::string& s) {
+			// Fail on forgotten input
+			if ( str_off > 0 ) throw forgotten_state_error(0, str_off, newlines_off);
+			
+			// Take a private copy of all the input
+			if ( in ) {
+				while ( read(block_size) > 0 ) {}
+				in = 0;
+			}
+			if ( buf != str.data() ) str.assign(buf + str_lo, buf + str_hi);
+			str.resize(str_hi);
+			file = 0;
+			
+			if ( i > str.size() || n > str.size() - i ) {
+				throw std::out_of_range("edit past end of input");
+			}
+			
+			// Replace the edited characters
+			str.erase(str.begin() + i, str.begin() + (i + n));
+			str.insert(str.begin() + i, s.begin(), s.end());
+			buf = str.data();
+			str_hi = str.size();
+			
+			// Discard memoized results before the edit which examined the 
+			// edited input
+			ind e = i + n;
+			auto after = memos.lower_bound(memo_key(e, 0));
+			for (auto it = memos.begin(); it != after;) {
+				if ( it->second->reach > i ) it = memos.erase(it);
+				else ++it;
+			}
+			
+			// Move the results after the edit with their input; they stay in 
+			// index order, so are reinserted at the end of the table
+			ind d = s.size() - n;  // wraps around for shrinking edits
+			if ( d != 0 ) {
+				std::vector<std::pair<memo_key, std::unique_ptr<memo_entry>>> moved;
+				for (auto it = after; it != memos.end(); ++it) {
+					memo_entry& m = *it->second;
+					m.end += d;
+					m.reach += d;
+					moved.emplace_back(memo_key(it->first.first + d, it->first.second), 
+					                   std::move(it->second));
+				}
+				memos.erase(after, memos.end());
+				for (auto it = moved.begin(); it != moved.end(); ++it) {
+					memos.emplace_hint(memos.end(), it->first, std::move(it->second));
+				}
+			}
+			
+			pos = 0;
+			str_max = 0;
+			restart_lines();
+			fail_pos = 0;
+			n_fails = 0;
 		}
 
 		/** Retrieves the maximum position inside the input that we have
 		 *  read so far.
-		 *  @return The number of characters we have read so far
+		 *  @return One past the maximum index the parser has requested
 		 */
 		size_type maxRead() const {
-			return str_off + str.size();
+			return str_max;
+		}
+		
+		/** Records that the terminal e was expected at the current position, 
+		 *  if that is at least as far into the input as any failure so far. 
+		 *  Called by matchers when they fail; expectations are not recorded 
+		 *  while muted.
+		 *  @param e		The expected terminal
+		 *  @return false, for use as a failing matcher
+		 */
+		bool expect(const expectation& e) {
+			if ( pos < fail_pos || quiet > 0 ) return false;
+			
+			// Terminals retried by backtracking are recorded again, and only 
+			// removed when the table fills, keeping this path branch-free
+			if ( pos > fail_pos ) n_fails = 0;
+			fail_pos = pos;
+			if ( n_fails == max_expected ) {
+				compact_fails();
+				if ( n_fails == max_expected ) return false;
+			}
+			fails[n_fails++] = e;
+			return false;
+		}
+		
+		/** Stops recording expectations until a matching unmute(), as inside 
+		 *  a negative lookahead, where a failure is not an error. */
+		void mute() { ++quiet; }
+		
+		/** Undoes a call to mute() */
+		void unmute() { --quiet; }
+		
+		/** Gets the furthest position a terminal failed to match at 
+		 *  (ignoring the failures before any forgotten input) */
+		size_type failPos() const {
+			return fail_pos;
+		}
+		
+		/** Gets the distinct terminals which failed to match at failPos(), 
+		 *  in the order they were tried (up to max_expected of them) */
+		std::vector<expectation> expected() const {
+			std::vector<expectation> es;
+			for (size_type i = 0; i < n_fails; ++i) {
+				if ( std::find(es.begin(), es.end(), fails[i]) == es.end() ) {
+					es.push_back(fails[i]);
+				}
+			}
+			return es;
+		}
+		
+		/** Gets the line and column of an input index. Lines are counted 
+		 *  incrementally from the last index located (or forgotten to), so 
+		 *  locating increasing indices reads each character only once.
+		 *  @param i		The index to locate
+		 *  @throws forgotten_state_error on i < str_begin (that is, asking for 
+		 *  		input previously discarded)
+		 */
+		location locate(size_type i) {
+			if ( i < str_off ) throw forgotten_state_error(i, str_off, newlines_off);
+			
+			if ( i < line_pos ) restart_lines();
+			count_lines(i);
+			return location(line_num + 1, i - line_start + 1);
+		}
+		
+		/** Gets the characters of the line containing index i, reading up to 
+		 *  the end of the line if needed. The range starts at the beginning 
+		 *  of the line, or of the input not yet forgotten, and is 
+		 *  invalidated as for range().
+		 *  @param i		An index in the line
+		 *  @throws forgotten_state_error on i < str_begin (that is, asking for 
+		 *  		input previously discarded)
+		 */
+		range_type line(size_type i) {
+			size_type b = std::max(i - (locate(i).column - 1), str_off);
+			size_type e = i;
+			while ( true ) {
+				value_type c = (*this)[e];
+				if ( c == '\n' || c == '\r' || e - str_off >= str_hi - str_lo ) break;
+				++e;
+			}
+			const char* base = buf + str_lo;
+			return range_type(base + (b - str_off), base + (e - str_off));
 		}
 		
 	private:
+		/** Resets everything but the input source to its initial state */
+		void restart() {
+			pos = 0;
+			str_lo = str_hi = str_off = str_max = 0;
+			newlines_off = line_pos = line_num = line_start = line_off = 0;
+			fail_pos = n_fails = quiet = 0;
+			in = 0;
+			file = 0;
+			pushing = false;
+			memos.clear();
+			nodes.reset();
+			tree.clear();
+		}
+		
+		/** Removes repeated terminals from the expected terminals */
+		void compact_fails() {
+			size_type n = 0;
+			for (size_type i = 0; i < n_fails; ++i) {
+				size_type j = 0;
+				while ( j < n && ! fails[j].same(fails[i]) ) ++j;
+				if ( j == n ) fails[n++] = fails[i];
+			}
+			n_fails = n;
+		}
+		
+		/** Restarts the line count from the start of the input not yet 
+		 *  forgotten */
+		void restart_lines() {
+			line_pos = str_off;
+			line_num = newlines_off;
+			line_start = line_off;
+		}
+		
+		/** Continues the line count up to index i (or the end of the input 
+		 *  read so far, if less), which must not be before line_pos */
+		void count_lines(size_type i) {
+			size_type e = std::min(i, str_off + (str_hi - str_lo));
+			if ( e <= line_pos ) return;
+			
+			const char* begin = buf + str_lo + (line_pos - str_off);
+			const char* it = begin;
+			const char* end = begin + (e - line_pos);
+			while ( const void* nl = std::memchr(it, '\n', end - it) ) {
+				++line_num;
+				it = static_cast<const char*>(nl) + 1;
+			}
+			if ( it != begin ) line_start = line_pos + (it - begin);
+			line_pos = e;
+		}
+		
 		/** Read more characters into the parser.
-		 *  @param n		The number of characters to read
+		 *  At least n characters are read if available; further characters 
+		 *  are read into free buffer space if the input stream can supply 
+		 *  them without blocking.
+		 *  @param n		The number of characters needed
 		 *  @return The number of characters read
 		 */
 		size_type read(size_type n) {
-			char s[n];
-			// Read into buffer
-			in.read(s, n);
-			// Count read characters
-			ind r = in.gcount();
-			// Add to stored input
-			str.insert(str.end(), s, s+r);
+			// In-memory and push-mode input is already all present
+			if ( ! in ) return 0;
+			
+			reserve(n);
+			
+			// Read as much buffered input as will fit, but at least n
+			size_type r = n;
+			std::streamsize avail = in->rdbuf() ? in->rdbuf()->in_avail() : 0;
+			if ( avail > 0 && size_type(avail) > r ) {
+				r = std::min(size_type(avail), str.size() - str_hi);
+			}
+			in->read(str.data() + str_hi, r);
+			r = in->gcount();
+			str_hi += r;
+#ifdef PARSE_STATS
+			++stats.reads;
+#endif
+			count_input(r);
 			return r;
 		}
 		
+		/** Counts n characters added to the input, if PARSE_STATS is 
+		 *  defined */
+		void count_input(size_type n) {
+#ifdef PARSE_STATS
+			stats.chars += n;
+			stats.max_window = std::max(stats.max_window, str_hi - str_lo);
+#else
+			(void)n;
+#endif
+		}
+		
+		/** Makes room for n more characters at the end of the input buffer, 
+		 *  compacting or growing it as needed.
+		 *  @param n		The number of characters to make room for
+		 */
+		void reserve(size_type n) {
+			if ( str.size() - str_hi < n ) {
+				size_type len = str_hi - str_lo;
+				size_type cap = str.empty() ? block_size : str.size();
+				while ( cap < len + n ) cap *= 2;
+				
+				if ( cap == str.size() ) {
+					// Compact in place
+					std::memmove(str.data(), str.data() + str_lo, len);
+				} else {
+					// Move to larger buffer
+					std::vector<value_type> nstr(cap);
+					if ( len > 0 ) std::memcpy(nstr.data(), str.data() + str_lo, len);
+					str.swap(nstr);
+				}
+				buf = str.data();
+				str_lo = 0;
+				str_hi = len;
+			}
+		}
+		
 	public:
 		/** Current parsing location */
 		size_type pos;
+		/** Arena for semantic actions to build results in; freed with the 
+		 *  state, and reset by reset() */
+		arena nodes;
+		/** Syntax tree of the rules matched, built by parsers generated 
+		 *  with `egg --cst`; cleared by reset() */
+		cst_tree tree;
+#ifdef PARSE_STATS
+		/** Counters of the work done by the state; not cleared by reset(), 
+		 *  so they total the work of a series of inputs */
+		state_stats stats;
+#endif
 		
 	private:
-		/** Characters currently in use by the parser */
-		std::deque<value_type> str;
-		/** Offset of start of str from the beginning of the stream */
+		/** Input buffer for stream input */
+		std::vector<value_type> str;
+		/** Padded copy of the end of the input, for window() */
+		std::vector<value_type> pad;
+		/** Input characters; either str.data() or external in-memory input. 
+		 *  Characters in use by the parser are those in [str_lo, str_hi) */
+		const value_type* buf;
+		/** Index in buf of the first character in use */
+		size_type str_lo;
+		/** Index in buf past the last character read */
+		size_type str_hi;
+		/** Offset of buf[str_lo] from the beginning of the stream */
 		size_type str_off;
+		/** One past the maximum index requested so far */
+		size_type str_max;
 		/** Number of newlines we have already forgotten about */
 		size_type newlines_off;
-		/** Input stream to read characters from */
-		std::istream& in;
+		/** Index the line count has reached */
+		size_type line_pos;
+		/** Number of newlines before line_pos */
+		size_type line_num;
+		/** Index of the start of the line containing line_pos */
+		size_type line_start;
+		/** Index of the start of the line containing str_off */
+		size_type line_off;
+		/** Furthest index a terminal failed to match at */
+		size_type fail_pos;
+		/** Terminals which failed to match at fail_pos, possibly repeated */
+		expectation fails[max_expected];
+		/** Number of terminals in fails */
+		size_type n_fails;
+		/** Depth of calls to mute() */
+		size_type quiet;
+		/** Input stream to read characters from (null for in-memory input) */
+		std::istream* in;
+		/** Mapped file providing in-memory input (null if none) */
+		const mapped_file* file;
+		/** Is more input to be passed to feed()? */
+		bool pushing;
+		
+		/** Memo table key; ( index, rule identifier ) */
+		typedef std::pair<ind, ind> memo_key;
+		/** Memoized rule results, ordered by input index */
+		std::map<memo_key, std::unique_ptr<memo_entry>> memos;
 	}; /* class state */
+	
+	/** Parser state for in-memory input followed by a '\0', such as the 
+	 *  contents of a std::string::c_str(), which indexes the input without 
+	 *  checking for the end of the buffer, forgotten input, or the maximum 
+	 *  index read. Generated matchers are templates over the parser state 
+	 *  type, so those compiled with `egg --state parse::unchecked_state` 
+	 *  inline this operator[] into a direct load. The matchers never read 
+	 *  past a '\0', which ends the input (any past it are never read); 
+	 *  as maxRead() is not tracked, this state cannot be edit()ed, and 
+	 *  profiles of parsers using it count no backtracks. 
+	 *  Indexing input forgotten by a cut is undefined. */
+	class unchecked_state : public state {
+	public:
+		/** Initializes state at beginning of the given characters, which are 
+		 *  not copied, and must remain valid for the lifetime of the state.
+		 *  @param data		The input characters, with data[len] == '\0'
+		 *  @param len		The number of input characters
+		 */
+		unchecked_state(const char* data, size_type len) : state(data, len), data(data) {}
+		
+		/** Indexing operator.
+		 *  @param i		The index of the character to get, at most the 
+		 *  				length of the input
+		 *  @return The i'th character of the input, or '\0' at its end
+		 */
+		value_type operator[] (size_type i) const { return data[i]; }
+		
+		/** Resets the state to the beginning of the given characters; see 
+		 *  state::reset(std::istream&).
+		 *  @param data		The input characters, with data[len] == '\0'
+		 *  @param len		The number of input characters
+		 */
+		void reset(const char* data, size_type len) {
+			state::reset(data, len);
+			this->data = data;
+		}
+		
+		void reset(std::istream& in) = delete;
+		void reset(const mapped_file& f) = delete;
+		void reset() = delete;
+		void feed(const char* data, size_type len) = delete;
+		void edit(size_type i, size_type n, const std::string& s) = delete;
+		
+	private:
+		const value_type* data;	/**< Input characters */
+	}; /* class unchecked_state */
 
 	/** A generic parse result. */
 	struct value {
@@ -251,57 +1666,156 @@ namespace parse {
 	const failure fails = 0;
 
 	/** Wraps a parsing result. ps[ps.pos++]
-	 *  Returns either the wrapped result or false.
-	 *  @param T The wrapped result; should be default constructable. */
+	 *  Returns either the wrapped result or false. The wrapped value is 
+	 *  only constructed on success, and is moved rather than copied where 
+	 *  possible.
+	 *  @param T The wrapped result; need only be default constructable for 
+	 *           the conversion operators on failure. */
 	template<typename T = value> 
 	class result {
 	public:
-		result(const T& v) : val(v), success(true) {}
+		result(const T& v) : success(true) { new(&val) T(v); }
+		result(T&& v) : success(true) { new(&val) T(std::move(v)); }
 		result(const failure& f) : success(false) {}
 		result() : success(false) {}
+		
+		result(const result<T>& o) : success(o.success) {
+			if ( success ) new(&val) T(o.val);
+		}
+		
+		result(result<T>&& o) : success(o.success) {
+			if ( success ) new(&val) T(std::move(o.val));
+		}
+		
+		~result() { if ( success ) val.~T(); }
 
 		/** Sets the result to a success containing v */
 		result<T>& operator = (const T& v) { 
-			val = v; success = true; return *this;
+			if ( success ) { val = v; }
+			else { new(&val) T(v); success = true; }
+			return *this;
+		}
+		
+		/** Sets the result to a success containing v, moved from */
+		result<T>& operator = (T&& v) { 
+			if ( success ) { val = std::move(v); }
+			else { new(&val) T(std::move(v)); success = true; }
+			return *this;
 		}
 
 		/** Sets the result to a failure */
 		result<T>& operator = (const failure& f) { 
-			success = false; return *this;
+			if ( success ) { val.~T(); success = false; }
+			return *this;
 		}
 
 		/** Copies a result */
 		result<T>& operator = (const result<T>& o) {
-			if ( o.success ) { success = true; val = o.val; }
-			else { success = false; }
+			if ( o.success ) { *this = o.val; }
+			else { *this = fails; }
+			return *this;
+		}
+		
+		/** Moves a result */
+		result<T>& operator = (result<T>&& o) {
+			if ( o.success ) { *this = std::move(o.val); }
+			else { *this = fails; }
 			return *this;
 		}
 
-		/** Gets result value out */
-		operator T () { return val; }
+		/** Gets result value out (default value on failure) */
+		operator T () const & { return success ? val : T(); }
+		operator T () && { return success ? std::move(val) : T(); }
 
-		/** Gets the success value out */
-		operator bool () { return success; }
+		/** Gets the success value out; qualified like the conversion to T, 
+		 *  so that an rvalue result tests its success, not its value */
+		operator bool () const & { return success; }
+		operator bool () && { return success; }
 
 		/** Gets result value out (explicit operator) */
-		T operator * () { return val; }
+		T operator * () const & { return success ? val : T(); }
+		T operator * () && { return success ? std::move(val) : T(); }
 
 		/** Binds the result (if successful) to a value */
-		result<T>& operator () (T& bind) {
+		result<T>& operator () (T& bind) & {
 			if ( success ) { bind = val; }
 			return *this;
 		}
 		
+		/** Binds a temporary result (if successful) to a value, moving the 
+		 *  value out of it */
+		result<T>& operator () (T& bind) && {
+			if ( success ) { bind = std::move(val); }
+			return *this;
+		}
+		
 	private:
-		T val;			/**< The wrapped value. */
+		union {
+			T val;		/**< The wrapped value (constructed on success). */
+		};
 		bool success;	/**< The success of the parse. */
 	}; /* class result<T> */
 
+	/** Matches a series of inputs with a rule, one at a time, resetting 
+	 *  the same parser state for each; the buffers of the state, and the 
+	 *  memory of the arena semantic actions build results in (ps.nodes), 
+	 *  are reused, so a parser which has grown to fit its inputs can match 
+	 *  more without allocating (except for memoized results). Rules keep 
+	 *  no state of their own (unless compiled with `egg --profile`), so 
+	 *  threads may match inputs concurrently, each with its own parser.
+	 *  @param T		The type of the rule's result
+	 *  @param S		The type of parser state the rule takes
+	 */
+	template<typename T, typename S = state>
+	class parser {
+	public:
+		typedef result<T> (*rule_type)(S&);
+		
+		/** Makes a parser which matches inputs with the given rule */
+		parser(rule_type rule) : rule(rule), ps(0, 0) {}
+		
+		/** Matches in-memory input; the characters are not copied, and must 
+		 *  remain valid until the next match. The result is only valid 
+		 *  until then as well, if it refers to the state's arena.
+		 *  @param data		The input characters ('\0'-terminated, if S is 
+		 *  				unchecked_state)
+		 *  @param len		The number of input characters
+		 */
+		result<T> operator() (const char* data, ind len) {
+			ps.reset(data, len);
+			return rule(ps);
+		}
+		
+		/** Matches the characters of a string; see above */
+		result<T> operator() (const std::string& s) {
+			return (*this)(s.c_str(), s.size());
+		}
+		
+		/** Matches input from a stream; see above */
+		result<T> operator() (std::istream& in) {
+			ps.reset(in);
+			return rule(ps);
+		}
+		
+		/** The parser state, as left by the last match (for its position, 
+		 *  failure information, and arena) */
+		S& context() { return ps; }
+		
+	private:
+		parser(const parser&);
+		parser& operator= (const parser&);
+		
+		rule_type rule;	/**< Rule to match inputs with */
+		S ps;			/**< Parser state, reset for each input */
+	}; /* class parser<T, S> */
+	
 	/** Builds a positive result from a value.
 	 *  @param T	The type of the wrapped result	
-	 *  @param v	The value to wrap. */
+	 *  @param v	The value to wrap; moved from if an rvalue. */
 	template<typename T>
-	result<T> match(const T& v) { return result<T>(v); }
+	result<typename std::decay<T>::type> match(T&& v) { 
+		return result<typename std::decay<T>::type>(std::forward<T>(v));
+	}
 
 	/** Builds a failure result.
 	 *  @param T	The type of the failure result. */
@@ -309,22 +1823,29 @@ namespace parse {
 	result<T> fail() { return result<T>(fails); }
 	
 	/** Matcher for any character */
-	result<state::value_type> any(state& ps) {
-		if ( ps[ps.pos] == '\0' ) return fail<state::value_type>();
+	template<typename S>
+	result<state::value_type> any(S& ps) {
+		if ( ps[ps.pos] == '\0' ) {
+			ps.expect(expectation::any());
+			return fail<state::value_type>();
+		}
 		return match(ps[ps.pos++]);
 	}
 
 	/** Matcher for a given character */
-	template<state::value_type c>
-	result<state::value_type> matches(parse::state& ps) {
-		if ( ps[ps.pos] != c ) return fail<state::value_type>();
+	template<state::value_type c, typename S>
+	result<state::value_type> matches(S& ps) {
+		if ( ps[ps.pos] != c ) {
+			ps.expect(expectation::character(c));
+			return fail<state::value_type>();
+		}
 		++ps.pos;
 		return match(c);
 	}
 
 	/** Matcher for a character range */
-	template<state::value_type s, state::value_type e>
-	result<state::value_type> in_range(parse::state& ps) {
+	template<state::value_type s, state::value_type e, typename S>
+	result<state::value_type> in_range(S& ps) {
 		state::value_type c = ps[ps.pos];
 		if ( c < s || c > e ) return fail<state::value_type>();
 		
@@ -332,5 +1853,520 @@ namespace parse {
 		return match(c);
 	}
 	
+	/** Matcher for a character class */
+	template<const char_set& s, typename S>
+	result<state::value_type> in_set(S& ps) {
+		state::value_type c = ps[ps.pos];
+		if ( ! s.contains(c) ) {
+			ps.expect(expectation::set(s));
+			return fail<state::value_type>();
+		}
+		
+		++ps.pos;
+		return match(c);
+	}
+	
+	/** Matcher for a string literal; compares against a window of the 
+	 *  input in bulk.
+	 *  @param s		The literal characters, none of which are '\0'
+	 *  @param n		The number of characters in s
+	 */
+	template<typename S>
+	bool literal(S& ps, const state::value_type* s, ind n) {
+		const state::value_type* w = ps.window(ps.pos, n);
+		
+		if ( std::memcmp(w, s, n) == 0 ) {
+			ps.examined(ps.pos + n);
+			ps.pos += n;
+			return true;
+		}
+		
+		// mark as read up to the mismatch, as if checked character-by-character
+		ps.examined(ps.pos + ( std::mismatch(w, w + n, s).first - w ) + 1);
+		return ps.expect(expectation::string(s, n));
+	}
+	
+#ifdef PARSE_SIMD
+	/** Nibble lookup tables for testing 16 characters against a char_set 
+	 *  at once. Bit j of lo[i] is set if character 16*j + i is in the set, 
+	 *  bit j of hi[i] if character 16*(j+8) + i is. */
+	struct char_set_nibbles {
+		char_set_nibbles(const char_set& s) {
+			for (int i = 0; i < 16; ++i) {
+				lo[i] = hi[i] = 0;
+				for (int j = 0; j < 8; ++j) {
+					if ( s.contains(char(16*j + i)) ) lo[i] |= 1 << j;
+					if ( s.contains(char(16*(j+8) + i)) ) hi[i] |= 1 << j;
+				}
+			}
+		}
+		
+		unsigned char lo[16];	/**< Membership of characters 0x00-0x7f */
+		unsigned char hi[16];	/**< Membership of characters 0x80-0xff */
+	}; /* struct char_set_nibbles */
+#endif
+	
+	/** Finds the first character in [b, e) not in the character class s.
+	 *  Uses AVX2 or SSE4.1 to check 32 or 16 characters at a time, where 
+	 *  available.
+	 *  @return The first such character, or e if none */
+	template<const char_set& s>
+	const state::value_type* span_set(const state::value_type* b, 
+	                                  const state::value_type* e) {
+#ifdef PARSE_SIMD
+		static const char_set_nibbles t(s);
+		
+#ifdef __AVX2__
+		if ( e - b >= 32 ) {
+			const __m256i lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)t.lo));
+			const __m256i hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)t.hi));
+			const __m256i bits = _mm256_setr_epi8(
+				1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128, 
+				1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+			const __m256i nibble = _mm256_set1_epi8(0x0f);
+			do {
+				__m256i x = _mm256_loadu_si256((const __m256i*)b);
+				__m256i xl = _mm256_and_si256(x, nibble);
+				__m256i xh = _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble);
+				// row of the table for the low nibble, chosen by the high bit
+				__m256i row = _mm256_blendv_epi8(
+					_mm256_shuffle_epi8(lo, xl), _mm256_shuffle_epi8(hi, xl), x);
+				__m256i bit = _mm256_shuffle_epi8(bits, xh);
+				unsigned m = _mm256_movemask_epi8(
+					_mm256_cmpeq_epi8(_mm256_and_si256(row, bit), bit));
+				if ( m != 0xffffffffu ) return b + __builtin_ctz(~m);
+				b += 32;
+			} while ( e - b >= 32 );
+		}
+#endif
+		if ( e - b >= 16 ) {
+			const __m128i lo = _mm_loadu_si128((const __m128i*)t.lo);
+			const __m128i hi = _mm_loadu_si128((const __m128i*)t.hi);
+			const __m128i bits = _mm_setr_epi8(
+				1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+			const __m128i nibble = _mm_set1_epi8(0x0f);
+			do {
+				__m128i x = _mm_loadu_si128((const __m128i*)b);
+				__m128i xl = _mm_and_si128(x, nibble);
+				__m128i xh = _mm_and_si128(_mm_srli_epi16(x, 4), nibble);
+				// row of the table for the low nibble, chosen by the high bit
+				__m128i row = _mm_blendv_epi8(
+					_mm_shuffle_epi8(lo, xl), _mm_shuffle_epi8(hi, xl), x);
+				__m128i bit = _mm_shuffle_epi8(bits, xh);
+				unsigned m = _mm_movemask_epi8(
+					_mm_cmpeq_epi8(_mm_and_si128(row, bit), bit));
+				if ( m != 0xffffu ) return b + __builtin_ctz(~m);
+				b += 16;
+			} while ( e - b >= 16 );
+		}
+#endif
+		while ( b != e && s.contains(*b) ) ++b;
+		return b;
+	}
+	
+	/** Matcher for any number of characters in a character class; scans 
+	 *  the buffered input in bulk. Always matches. */
+	template<const char_set& s, typename S>
+	bool many_in_set(S& ps) {
+		while ( true ) {
+			state::range_type r = ps.buffered(ps.pos);
+			ind k = span_set<s>(r.first, r.second) - r.first;
+#ifdef PARSE_STATS
+			ps.stats.examined += k;
+#endif
+			ps.pos += k;
+			
+			// check the following character, reading more input if needed
+			if ( ! s.contains(ps[ps.pos]) ) return true;
+			++ps.pos;
+		}
+	}
+	
+	/** Matcher for at least one character in a character class; scans the 
+	 *  buffered input in bulk. */
+	template<const char_set& s, typename S>
+	bool some_in_set(S& ps) {
+		if ( ! s.contains(ps[ps.pos]) ) return ps.expect(expectation::set(s));
+		++ps.pos;
+		return many_in_set<s>(ps);
+	}
+
+	/** Gets the number of characters of the UTF-8 encoded codepoint at
+	 *  ps.pos if it is in the Unicode character class with ASCII members a
+	 *  and other members u, or 0 if it is not (or is not valid UTF-8).
+	 *  ASCII characters are checked against a without decoding. */
+	template<typename S>
+	ind code_at(S& ps, const char_set& a, const code_set& u) {
+		state::value_type c = ps[ps.pos];
+		if ( (unsigned char)c < 0x80 ) return a.contains(c) ? 1 : 0;
+
+		ind n = utf8_length(c);
+		if ( n == 0 ) return 0;
+		const state::value_type* w = ps.window(ps.pos, n);
+		ps.examined(ps.pos + n);
+		char32_t x;
+		return ( decode_utf8(w, n, x) && u.contains(x) ) ? n : 0;
+	}
+
+	/** Matcher for a codepoint in a Unicode character class, with ASCII
+	 *  members a and other members u */
+	template<const char_set& a, const code_set& u, typename S>
+	bool in_codes(S& ps) {
+		ind n = code_at(ps, a, u);
+		if ( n == 0 ) return ps.expect(expectation::named(u.name));
+		ps.pos += n;
+		return true;
+	}
+
+	/** Finds the first codepoint in [b, e) not in the Unicode character 
+	 *  class with ASCII members a and other members u. Runs of ASCII 
+	 *  members are scanned in bulk by span_set() (as a has no members past 
+	 *  ASCII, the scan also stops at the first non-ASCII character), and 
+	 *  only the other characters are decoded.
+	 *  @return The first such codepoint, or the start of a sequence which 
+	 *          does not end before e, or e if there is neither */
+	template<const char_set& a, const code_set& u>
+	const state::value_type* span_codes(const state::value_type* b, 
+	                                    const state::value_type* e) {
+		while ( b != e ) {
+			if ( (unsigned char)*b < 0x80 ) {
+				b = span_set<a>(b, e);
+				if ( b == e || (unsigned char)*b < 0x80 ) return b;
+			}
+			
+			ind n = utf8_length(*b);
+			char32_t c;
+			if ( n == 0 || ind(e - b) < n || ! decode_utf8(b, n, c) || ! u.contains(c) ) {
+				return b;
+			}
+			b += n;
+		}
+		return b;
+	}
+	
+	/** Matcher for any number of codepoints in a Unicode character class; 
+	 *  scans the buffered input in bulk with span_codes(). Always matches. */
+	template<const char_set& a, const code_set& u, typename S>
+	bool many_in_codes(S& ps) {
+		while ( true ) {
+			state::range_type r = ps.buffered(ps.pos);
+			ind k = span_codes<a, u>(r.first, r.second) - r.first;
+#ifdef PARSE_STATS
+			ps.stats.examined += k;
+#endif
+			ps.pos += k;
+
+			// check the following codepoint, reading more input if needed
+			ind n = code_at(ps, a, u);
+			if ( n == 0 ) return true;
+			ps.pos += n;
+		}
+	}
+
+	/** Matcher for at least one codepoint in a Unicode character class, as
+	 *  many_in_codes() */
+	template<const char_set& a, const code_set& u, typename S>
+	bool some_in_codes(S& ps) {
+		if ( ! in_codes<a, u>(ps) ) return false;
+		return many_in_codes<a, u>(ps);
+	}
+
+	/** Parses independent records in parallel.
+	 *  The input is split into chunks, each ending just after a delimiter 
+	 *  character (or at the end of the input), and the given rule is run on 
+	 *  each chunk, with its own parser state, by a pool of worker threads. 
+	 *  The results are passed to the callback in input order, on the 
+	 *  calling thread, as each becomes available. Semantic actions run on 
+	 *  the worker threads, so must not share unsynchronized state.
+	 *  @param data		The input characters
+	 *  @param len		The number of input characters
+	 *  @param rule		The rule to match each chunk with
+	 *  @param each		Callback taking the chunk (as a span) and the result 
+	 *  				of running rule on it (as a result<T>&)
+	 *  @param delim	The character ending each record
+	 *  @param threads	The number of worker threads (0 for one per core)
+	 *  @param chunk	The minimum size of a chunk in bytes (0 to choose 
+	 *  				one based on the input size and number of threads)
+	 *  @return Did the rule match every chunk?
+	 *  @throws any exception thrown by the rule on a chunk, once the 
+	 *  		results of the preceding chunks have been passed to each, or 
+	 *  		by each itself; the workers are stopped and joined first
+	 */
+	template<typename T, typename F>
+	bool parallel(const char* data, ind len, result<T> (*rule)(state&), F each, 
+	              char delim = '\n', unsigned threads = 0, ind chunk = 0) {
+		if ( threads == 0 ) threads = std::max(std::thread::hardware_concurrency(), 1u);
+		if ( chunk == 0 ) chunk = std::max(len / (4 * threads), ind(1) << 16);
+		
+		// Split the input after the first delimiter at or past each chunk 
+		// size interval
+		std::vector<ind> bounds(1, 0);
+		while ( bounds.back() < len ) {
+			ind b = bounds.back();
+			ind e = std::min(b + chunk, len) - 1;
+			const void* d = std::memchr(data + e, delim, len - e);
+			bounds.push_back(d ? static_cast<const char*>(d) - data + 1 : len);
+		}
+		ind n = bounds.size() - 1;
+		
+		std::vector<result<T>> results(n);
+		std::vector<std::exception_ptr> errors(n);
+		std::unique_ptr<bool[]> done(new bool[n]());
+		std::atomic<ind> next(0);
+		std::mutex m;
+		std::condition_variable cv;
+		
+		// Workers take the next unparsed chunk until there are none left
+		auto work = [&]() {
+			for (ind i = next++; i < n; i = next++) {
+				try {
+					state ps(data + bounds[i], bounds[i+1] - bounds[i]);
+					results[i] = rule(ps);
+				} catch (...) {
+					errors[i] = std::current_exception();
+				}
+				std::lock_guard<std::mutex> lock(m);
+				done[i] = true;
+				cv.notify_all();
+			}
+		};
+		std::vector<std::thread> pool;
+		bool ok = true;
+		std::exception_ptr error;
+		try {
+			for (unsigned t = 0; t < threads && t < n; ++t) pool.push_back(std::thread(work));
+			
+			// Deliver the results in order, releasing each once delivered
+			for (ind i = 0; i < n; ++i) {
+				{
+					std::unique_lock<std::mutex> lock(m);
+					while ( ! done[i] ) cv.wait(lock);
+				}
+				if ( errors[i] ) { error = errors[i]; next = n; break; }
+				if ( ! results[i] ) ok = false;
+				each(span(data + bounds[i], bounds[i+1] - bounds[i]), results[i]);
+				results[i] = fails;
+			}
+		} catch (...) {
+			// stop the workers, so they can be joined before rethrowing
+			error = std::current_exception();
+			next = n;
+		}
+		
+		for (auto it = pool.begin(); it != pool.end(); ++it) it->join();
+		if ( error ) std::rethrow_exception(error);
+		return ok;
+	}
+	
+	/** Parses the independent records of a file in parallel; see 
+	 *  parallel(const char*, ind, ...) */
+	template<typename T, typename F>
+	bool parallel(const mapped_file& f, result<T> (*rule)(state&), F each, 
+	              char delim = '\n', unsigned threads = 0, ind chunk = 0) {
+		return parallel(f.data(), f.size(), rule, each, delim, threads, chunk);
+	}
+	
+	/** Counters for one rule of a parser generated with `egg --profile`. 
+	 *  Profiled parsers keep a static table of these, which is not 
+	 *  synchronized, so should only be used by one thread at a time. */
+	struct rule_profile {
+		typedef std::chrono::steady_clock clock;
+		
+		rule_profile(const char* name) 
+			: name(name), calls(0), matches(0), fails(0), backtracks(0), bytes(0), 
+			  time(clock::duration::zero()), depth(0) {}
+		
+		const char* name;		/**< Name of the rule */
+		ind calls;				/**< Number of times the rule was called */
+		ind matches;			/**< Number of calls which matched */
+		ind fails;				/**< Number of calls which failed */
+		ind backtracks;			/**< Number of failed calls which examined input 
+		           				 *   past their first character before failing */
+		ind bytes;				/**< Input consumed by the calls which matched */
+		clock::duration time;	/**< Time spent in the rule, including the rules 
+		                     	 *   it called (recursive calls are not counted 
+		                     	 *   twice) */
+		ind depth;				/**< Number of calls currently running */
+	}; /* struct rule_profile */
+	
+	/** Calls a rule, recording the call in its profile.
+	 *  @param p		The profile of the rule
+	 *  @param ps		The parser state
+	 *  @param rule		The (unprofiled) rule to call
+	 *  @return The result of the rule
+	 */
+	template<typename T, typename S>
+	result<T> profile(rule_profile& p, S& ps, result<T> (*rule)(S&)) {
+		ind start = ps.pos;
+		state::size_type w = ps.watch();
+		++p.calls;
+		
+		// only the outermost of a set of recursive calls is timed
+		bool outer = p.depth++ == 0;
+		rule_profile::clock::time_point t;
+		if ( outer ) t = rule_profile::clock::now();
+		result<T> r;
+		try {
+			r = rule(ps);
+		} catch (...) {
+			--p.depth;
+			throw;
+		}
+		if ( outer ) p.time += rule_profile::clock::now() - t;
+		--p.depth;
+		
+		if ( r ) {
+			++p.matches;
+			p.bytes += ps.pos - start;
+		} else {
+			++p.fails;
+			if ( ps.maxRead() > start + 1 ) ++p.backtracks;
+		}
+		ps.unwatch(w);
+		return r;
+	}
+	
+	/** Prints a report of the rule profiles, sorted by descending time.
+	 *  @param out		The stream to print to
+	 *  @param ps		The rule profiles
+	 *  @param n		The number of rule profiles
+	 */
+	inline void dump_profile(std::ostream& out, const rule_profile* ps, ind n) {
+		std::vector<const rule_profile*> sorted;
+		for (ind i = 0; i < n; ++i) sorted.push_back(ps + i);
+		std::stable_sort(sorted.begin(), sorted.end(), 
+			[](const rule_profile* a, const rule_profile* b) { return a->time > b->time; });
+		
+		std::size_t w = 4;
+		for (ind i = 0; i < n; ++i) w = std::max(w, std::strlen(ps[i].name));
+		
+		std::ios::fmtflags flags = out.flags();
+		std::streamsize precision = out.precision();
+		char fill = out.fill(' ');
+		out << std::left << std::setw(w) << "rule" << std::right
+		    << std::setw(12) << "calls" << std::setw(12) << "matches" 
+		    << std::setw(12) << "fails" << std::setw(12) << "backtracks" 
+		    << std::setw(12) << "bytes" << std::setw(12) << "time(ms)" 
+		    << std::setw(10) << "ns/call" << "\n";
+		for (auto it = sorted.begin(); it != sorted.end(); ++it) {
+			const rule_profile& p = **it;
+			double ns = std::chrono::duration<double, std::nano>(p.time).count();
+			out << std::left << std::setw(w) << p.name << std::right
+			    << std::setw(12) << p.calls << std::setw(12) << p.matches 
+			    << std::setw(12) << p.fails << std::setw(12) << p.backtracks 
+			    << std::setw(12) << p.bytes 
+			    << std::fixed << std::setprecision(3) << std::setw(12) << ns / 1e6 
+			    << std::setprecision(1) << std::setw(10) << ( p.calls ? ns / p.calls : 0.0 ) 
+			    << "\n";
+		}
+		out.flags(flags);
+		out.precision(precision);
+		out.fill(fill);
+		out.flush();
+	}
+	
+	/** Prints a report of the counters of a parser state, followed by the 
+	 *  rules which reset the position, sorted by descending resets.
+	 *  @param out		The stream to print to
+	 *  @param s		The counters (see state::stats)
+	 *  @param names	The names of the rules, by identifier
+	 *  @param n		The number of rules
+	 */
+	inline void dump_stats(std::ostream& out, const state_stats& s, 
+	                       const char* const* names = 0, ind n = 0) {
+		std::ios::fmtflags flags = out.flags();
+		std::streamsize precision = out.precision();
+		out << std::fixed << std::setprecision(1)
+		    << "input:      " << s.chars << " chars in " << s.reads << " reads (" 
+		    << ( s.reads ? double(s.chars) / s.reads : 0.0 ) << " chars/read), " 
+		    << "max window " << s.max_window << " chars\n"
+		    << "examined:   " << s.examined << " chars (" 
+		    << ( s.chars ? double(s.examined) / s.chars : 0.0 ) << " per char of input)\n"
+		    << "backtracks: " << s.resets << " resets over " << s.backtracked << " chars\n"
+		    << "memo:       " << s.memo_hits << " hits, " << s.memo_misses << " misses (" 
+		    << ( s.memo_hits + s.memo_misses 
+		         ? 100.0 * s.memo_hits / (s.memo_hits + s.memo_misses) : 0.0 ) 
+		    << "% hits)\n";
+		
+		std::vector<ind> sorted;
+		for (ind i = 0; i < s.rule_resets.size(); ++i) {
+			if ( s.rule_resets[i] > 0 ) sorted.push_back(i);
+		}
+		std::stable_sort(sorted.begin(), sorted.end(), 
+			[&s](ind a, ind b) { return s.rule_resets[a] > s.rule_resets[b]; });
+		
+		std::size_t w = 4;
+		for (ind i = 0; i < n; ++i) w = std::max(w, std::strlen(names[i]));
+		char fill = out.fill(' ');
+		if ( ! sorted.empty() ) {
+			out << std::left << std::setw(w) << "rule" << std::right 
+			    << std::setw(12) << "resets" << "\n";
+		}
+		for (auto it = sorted.begin(); it != sorted.end(); ++it) {
+			out << std::left << std::setw(w);
+			if ( *it < n ) out << names[*it];
+			else out << *it;
+			out << std::right << std::setw(12) << s.rule_resets[*it] << "\n";
+		}
+		out.flags(flags);
+		out.precision(precision);
+		out.fill(fill);
+		out.flush();
+	}
+	
+	/** Handler for the events of a parser generated with `egg --sax`, 
+	 *  which ignores them; handlers need not derive from it, but may, to 
+	 *  handle only some events (the handler type is a template parameter, 
+	 *  so the events are not virtual, and are free to ignore). */
+	struct null_handler {
+		/** A rule is about to be matched at pos */
+		void enter(const char* /*rule*/, ind /*pos*/) {}
+		/** A rule has matched text, starting at pos */
+		void exit(const char* /*rule*/, ind /*pos*/, const span& /*text*/) {}
+		/** A rule has failed to match at pos */
+		void fail(const char* /*rule*/, ind /*pos*/) {}
+	}; /* struct null_handler */
+	
+	/** Calls a rule of a parser generated with `egg --sax`, passing the 
+	 *  events of the call to a handler.
+	 *  @param name		The name of the rule
+	 *  @param ps		The parser state
+	 *  @param h		The handler (see null_handler)
+	 *  @param rule		The rule to call, without events
+	 *  @return The result of the rule
+	 */
+	template<typename S, typename H>
+	result<> sax(const char* name, S& ps, H& h, result<> (*rule)(S&, H&)) {
+		ind start = ps.pos;
+		h.enter(name, start);
+		result<> r = rule(ps, h);
+		if ( r ) h.exit(name, start, ps.view(start, ps.pos - start));
+		else h.fail(name, start);
+		return r;
+	}
+	
+	/** Calls a rule of a parser generated with `egg --cst`, adding a node
+	 *  for the match to the syntax tree of the parser state, or removing
+	 *  the nodes added by the call if it fails.
+	 *  @param id		The identifier of the rule
+	 *  @param ps		The parser state
+	 *  @param rule		The rule to call, without a node
+	 *  @return The result of the rule
+	 */
+	template<typename T, typename S>
+	result<T> cst(ind id, S& ps, result<T> (*rule)(S&)) {
+		ind n = ps.tree.enter(id, ps.pos);
+		result<T> r;
+		try {
+			r = rule(ps);
+		} catch (...) {
+			ps.tree.fail(n);
+			throw;
+		}
+		if ( r ) ps.tree.exit(n, ps.pos);
+		else ps.tree.fail(n);
+		return r;
+	}
+
 } /* namespace parse */
 
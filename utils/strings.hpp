@@ -22,6 +22,7 @@
  * THE SOFTWARE.
  */
 
+#include <iomanip>
 #include <sstream>
 #include <string>
 
@@ -43,6 +44,44 @@ namespace strings {
 		}
 	}
 
+	/** Returns the UTF-8 encoding of the given Unicode codepoint. */
+	string utf8(const char32_t c) {
+		string s;
+		if ( c < 0x80 ) {
+			s += char(c);
+		} else if ( c < 0x800 ) {
+			s += char(0xc0 | (c >> 6));
+			s += char(0x80 | (c & 0x3f));
+		} else if ( c < 0x10000 ) {
+			s += char(0xe0 | (c >> 12));
+			s += char(0x80 | ((c >> 6) & 0x3f));
+			s += char(0x80 | (c & 0x3f));
+		} else {
+			s += char(0xf0 | (c >> 18));
+			s += char(0x80 | ((c >> 12) & 0x3f));
+			s += char(0x80 | ((c >> 6) & 0x3f));
+			s += char(0x80 | (c & 0x3f));
+		}
+		return s;
+	}
+
+	/** Returns a string representing the given Unicode codepoint, escaped 
+	 *  as for escape(char) if it is ASCII, and as a "\\u" escape (or a 
+	 *  "\\U" escape, past U+FFFF) if it is not or if always is set. */
+	string escape(const char32_t c, bool always = false) {
+		if ( c < 0x80 && ! always ) return escape(char(c));
+		stringstream ss;
+		ss << ( c > 0xffff ? "\\U" : "\\u" ) << std::hex << std::setfill('0') 
+		   << std::setw(c > 0xffff ? 8 : 4) << (unsigned long)c;
+		return ss.str();
+	}
+
+	/** Converts the hexadecimal digits of a "\\u" or "\\U" escape to a 
+	 *  codepoint. */
+	char32_t code_point(const string& hex) {
+		return char32_t(std::stoul(hex, 0, 16));
+	}
+
 	/** Returns a string representing the given string with all special 
 	 *  characters '\n', '\r', '\t', '\\', '\'', and '\"' backslash-escaped. */
 	string escape(const string& s) {
@@ -72,7 +111,14 @@ namespace strings {
 				++it;
 				if ( it == s.end() ) break;
 				c = *it;
-				ss << unescaped_char(c);
+				unsigned n = c == 'u' ? 4 : c == 'U' ? 8 : 0;
+				if ( n > 0 && (unsigned long)(s.end() - it) > n ) {
+					//Unicode escapes are encoded as UTF-8
+					ss << utf8(code_point(string(it + 1, it + 1 + n)));
+					it += n;
+				} else {
+					ss << unescaped_char(c);
+				}
 			} else {
 				ss << c;
 			}
@@ -22,12 +22,21 @@
  * THE SOFTWARE.
  */
 
+#include <algorithm>
+#include <array>
+#include <iomanip>
 #include <iostream>
 #include <map>
+#include <sstream>
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
+#include "first_set.hpp"
+#include "inlining.hpp"
+#include "left_recursion.hpp"
+#include "printer.hpp"
 #include "../ast.hpp"
 #include "../utils/strings.hpp"
 
@@ -36,9 +45,9 @@ namespace visitor {
 	/** Gets a list of variables declared in a grammar rule. */
 	class variable_list : ast::visitor {
 	public:
-		variable_list() {}
+		variable_list() : captured(false) {}
 
-		variable_list(const ast::grammar& g) {
+		variable_list(const ast::grammar& g) : captured(false) {
 			for (auto it = g.rs.begin(); it != g.rs.end(); ++it) {
 				ast::grammar_rule& r = **it;
 				types.insert(std::make_pair(r.name, r.type));
@@ -59,7 +68,9 @@ namespace visitor {
 
 		void visit(ast::any_matcher& m) {}
 		void visit(ast::empty_matcher& m) {}
-		void visit(ast::action_matcher& m) {}
+		void visit(ast::action_matcher& m) {
+			if ( uses_capture(m) ) captured = true;
+		}
 		
 		void visit(ast::opt_matcher& m) {
 			m.m->accept(this);
@@ -96,121 +107,529 @@ namespace visitor {
 		void visit(ast::capt_matcher& m) {
 			vars.insert(std::make_pair("psCatch", "parse::ind"));
 			vars.insert(std::make_pair("psCatchLen", "parse::ind"));
-			vars.insert(std::make_pair("psCapture", "std::string"));
 			m.m->accept(this);
 		}
 
+		void visit(ast::cut_matcher& m) {}
+
 		std::map<std::string, std::string> list(ast::matcher_ptr& m) {
 			vars.clear();
+			captured = false;
 			m->accept(this);
-			return vars;
+			return finish();
 		}
 		
 		std::map<std::string, std::string> list(ast::grammar_rule& r) {
 			vars.clear();
+			captured = false;
 			r.m->accept(this);
-			return vars;
+			return finish();
+		}
+		
+		/** Does the action refer to the captured string? */
+		static bool uses_capture(const ast::action_matcher& m) {
+			return m.a.find("psCapture") != std::string::npos;
 		}
 		
 	private:
+		/** Declares psCapture if there is a capture which an action reads */
+		std::map<std::string, std::string>& finish() {
+			if ( captured && vars.count("psCatch") ) {
+				vars.insert(std::make_pair("psCapture", "parse::span"));
+			}
+			return vars;
+		}
+		
 		/** map of grammar rule names to types */
 		std::unordered_map<std::string, std::string> types;
 		/** map of variable names to types */
 		std::map<std::string, std::string> vars;
+		/** does an action refer to psCapture? */
+		bool captured;
 	}; /* class variable_list */
 	
-	/** Code generator for Egg matcher ASTs */
-	class compiler : ast::visitor {
+	/** Gets the distinct character classes used in a grammar, each of which 
+	 *  is compiled to a single parse::char_set table; Unicode classes also 
+	 *  have a table of the ranges of their members past ASCII, as in 
+	 *  parse::code_set. */
+	class char_class_list : ast::visitor {
 	public:
-		compiler(std::string name, std::ostream& out = std::cout) 
-			: name(name), out(out), tabs(2) {}
+		/** Membership bits of a character class, as in parse::char_set */
+		typedef std::array<unsigned long long, 4> table;
+		/** Codepoint ranges of a Unicode class, as in parse::code_set */
+		typedef std::vector<std::pair<char32_t, char32_t>> code_table;
 
-		void visit(ast::char_matcher& m) {
-			out << "parse::matches<\'" << strings::escape(m.c) << "\'>(ps)";
+		char_class_list() {}
+
+		char_class_list(const ast::grammar& g) {
+			for (auto it = g.rs.begin(); it != g.rs.end(); ++it) {
+				(*it)->m->accept(this);
+			}
 		}
 
-		void visit(ast::str_matcher& m) {
-			std::string indent(++tabs, '\t');
+		void visit(ast::char_matcher& m) {}
+		void visit(ast::str_matcher& m) {}
+
+		void visit(ast::range_matcher& m) {
+			if ( ! tabled(m) && ! m.utf8 ) return;
 			
-			//setup lambda to match string
-			out << "[&ps]() {" << std::endl
-				<< indent << "parse::ind psStart = ps.pos;" << std::endl
-				<< std::endl
-				<< indent << "if ( "
-				;
+			table t = of(m);
+			if ( ids.count(t) == 0 ) {
+				ids.insert(std::make_pair(t, tables.size()));
+				tables.push_back(t);
+			}
+			
+			if ( ! m.utf8 ) return;
+			std::string n = printer::char_class(m);
+			if ( code_ids.count(n) == 0 ) {
+				code_ids.insert(std::make_pair(n, codes.size()));
+				codes.push_back(codes_of(m));
+				names.push_back(n);
+			}
+		}
 
-			//match each character in the string
-			if ( m.s.empty() ) {
-				out << "true";
-			} else {
-				auto it = m.s.begin();
-				out << "\'" << strings::escape(*it) << "\' == ps[ps.pos++]";
-				while ( ++it != m.s.end() ) {
-					out << std::endl 
-						<< indent << "&& \'" << strings::escape(*it) << "\' == ps[ps.pos++]"
-						;
+		void visit(ast::rule_matcher& m) {}
+		void visit(ast::any_matcher& m) {}
+		void visit(ast::empty_matcher& m) {}
+		void visit(ast::action_matcher& m) {}
+		
+		void visit(ast::opt_matcher& m) {
+			m.m->accept(this);
+		}
+
+		void visit(ast::many_matcher& m) {
+			m.m->accept(this);
+		}
+
+		void visit(ast::some_matcher& m) {
+			m.m->accept(this);
+		}
+
+		void visit(ast::seq_matcher& m) {
+			for (auto it = m.ms.begin(); it != m.ms.end(); ++it) {
+				(*it)->accept(this);
+			}
+		}
+		
+		void visit(ast::alt_matcher& m) {
+			for (auto it = m.ms.begin(); it != m.ms.end(); ++it) {
+				(*it)->accept(this);
+			}
+		}
+
+		void visit(ast::look_matcher& m) {
+			m.m->accept(this);
+		}
+
+		void visit(ast::not_matcher& m) {
+			m.m->accept(this);
+		}
+
+		void visit(ast::capt_matcher& m) {
+			m.m->accept(this);
+		}
+
+		void visit(ast::cut_matcher& m) {}
+
+		/** Does the character class need a table? (Classes which are empty 
+		 *  or a single character have simpler matchers, and Unicode classes 
+		 *  are matched with their code tables) */
+		static bool tabled(const ast::range_matcher& m) {
+			if ( m.utf8 || m.rs.empty() ) return false;
+			if ( ! m.neg && m.rs.size() == 1 && m.rs.front().single() ) return false;
+			return true;
+		}
+
+		/** Gets the membership table for a character class (for a Unicode 
+		 *  class, of its ASCII members) */
+		static table of(const ast::range_matcher& m) {
+			table t = {{ 0, 0, 0, 0 }};
+			char32_t last = m.utf8 ? 0x7f : 0xff;
+			for (auto it = m.rs.begin(); it != m.rs.end(); ++it) {
+				for (char32_t c = it->from; c <= it->to && c <= last; ++c) {
+					t[c >> 6] |= 1ull << (c & 63);
 				}
 			}
+			if ( m.neg ) {
+				//like parse::any(), the end-of-input '\0' doesn't match
+				for (unsigned i = 0; i <= last >> 6; ++i) { t[i] = ~t[i]; }
+				t[0] &= ~1ull;
+			}
+			return t;
+		}
+
+		/** Gets the sorted, disjoint ranges of the members of a Unicode 
+		 *  class past ASCII */
+		static code_table codes_of(const ast::range_matcher& m) {
+			code_table rs;
+			for (auto it = m.rs.begin(); it != m.rs.end(); ++it) {
+				if ( it->to < 0x80 ) continue;
+				rs.push_back(std::make_pair(std::max<char32_t>(it->from, 0x80), it->to));
+			}
+			std::sort(rs.begin(), rs.end());
+			code_table u;
+			for (auto it = rs.begin(); it != rs.end(); ++it) {
+				if ( ! u.empty() && it->first <= u.back().second + 1 ) {
+					u.back().second = std::max(u.back().second, it->second);
+				} else {
+					u.push_back(*it);
+				}
+			}
+			if ( ! m.neg ) return u;
 			
-			//close lambda
-			out << " ) { return true; }" << std::endl
-				<< indent << "else { ps.pos= psStart; return false; }" << std::endl
-				<< indent << "}()";
+			//complement within the non-ASCII codepoints
+			code_table c;
+			char32_t next = 0x80;
+			for (auto it = u.begin(); it != u.end(); ++it) {
+				if ( it->first > next ) c.push_back(std::make_pair(next, it->first - 1));
+				next = it->second + 1;
+			}
+			if ( next <= 0x10ffff ) c.push_back(std::make_pair(next, char32_t(0x10ffff)));
+			return c;
+		}
 
-			--tabs;
+		/** Gets the index of the table for a character class */
+		unsigned long index(const ast::range_matcher& m) const {
+			return ids.at(of(m));
 		}
 
-		void visit(ast::range_matcher& m) {
-			std::string indent(++tabs, '\t');
+		/** Gets the index of the code table for a Unicode class */
+		unsigned long code_index(const ast::range_matcher& m) const {
+			return code_ids.at(printer::char_class(m));
+		}
 
-			//chain matcher ranges
-			out << "( ";
-			if ( m.rs.empty() ) {
-				out << "true";
-			} else {
-				auto it = m.rs.begin();
-				if ( it->single() ) {
-					out << "parse::matches<\'" << strings::escape(it->to) << "\'>(ps)";
+		std::vector<table> tables;	/**< Distinct tables, in order of use */
+		std::vector<code_table> codes;	/**< Code tables, in order of use */
+		std::vector<std::string> names;	/**< Source of the class of each code table */
+
+	private:
+		/** Indices of tables */
+		std::map<table, unsigned long> ids;
+		/** Indices of code tables, by the source of their class */
+		std::map<std::string, unsigned long> code_ids;
+	}; /* class char_class_list */
+	
+	/** A trie of the literals of an alternation made only of character and 
+	 *  string literals (and the small character classes the optimizer 
+	 *  merges single characters into), which visitor::compiler matches by 
+	 *  switching on each input character once, rather than trying each 
+	 *  literal in turn. */
+	class keyword_trie {
+	public:
+		/** Index for no literal */
+		static const unsigned long none = ~0ul;
+		
+		/** Largest character class to add to a trie, by characters */
+		static const unsigned long max_set = 16;
+
+		/** A node of the trie, for a prefix of one or more literals */
+		struct node {
+			node() : end(none), least(none) {}
+
+			/** Children of this node, by the next character, in order of 
+			 *  insertion */
+			std::vector<std::pair<char, unsigned long>> next;
+			unsigned long end;		/**< Index of the first literal ending here */
+			unsigned long least;	/**< Least index of a literal with this prefix */
+		};
+
+		/** Builds the trie of the literals of an alternation.
+		 *  @return false if the alternation has fewer than two alternatives, 
+		 *          or one which is not a non-empty literal or small class */
+		bool build(const ast::alt_matcher& m) {
+			ls.clear();
+			sets.clear();
+			nodes.assign(1, node());
+			width = 0;
+			if ( m.ms.size() < 2 ) return false;
+
+			for (auto it = m.ms.begin(); it != m.ms.end(); ++it) {
+				if ( (*it)->type() == ast::char_type ) {
+					ls.push_back(std::string(1, ast::as_ptr<ast::char_matcher>(*it)->c));
+					sets.push_back(false);
+				} else if ( (*it)->type() == ast::str_type 
+						&& ! ast::as_ptr<ast::str_matcher>(*it)->s.empty() ) {
+					ls.push_back(ast::as_ptr<ast::str_matcher>(*it)->s);
+					sets.push_back(false);
+				} else if ( (*it)->type() == ast::range_type ) {
+					std::string cs = chars(*ast::as_ptr<ast::range_matcher>(*it));
+					if ( cs.empty() || cs.size() > max_set ) return false;
+					ls.push_back(cs);
+					sets.push_back(true);
+				} else return false;
+			}
+
+			for (unsigned long i = 0; i < ls.size(); ++i) {
+				if ( size(i) > width ) width = size(i);
+				nodes[0].least = std::min(nodes[0].least, i);
+				
+				if ( sets[i] ) {
+					//one single-character literal for each character of a class
+					for (auto c = ls[i].begin(); c != ls[i].end(); ++c) add(0, c, c + 1, i);
 				} else {
-					out << "parse::in_range<\'" << strings::escape(it->from)
-							<< "\',\'" << strings::escape(it->to) << "\'>(ps)";
+					add(0, ls[i].begin(), ls[i].end(), i);
 				}
-				while ( ++it != m.rs.end() ) {
-					out << std::endl
-						<< indent << "|| "
-						;
-					if ( it->single() ) {
-						out << "parse::matches<\'" << strings::escape(it->to) << "\'>(ps)";
-					} else {
-						out << "parse::in_range<\'" << strings::escape(it->from)
-								<< "\',\'" << strings::escape(it->to) << "\'>(ps)";
-					}
+			}
+			return true;
+		}
+		
+		/** Gets the number of characters literal j matches */
+		unsigned long size(unsigned long j) const { return sets[j] ? 1 : ls[j].size(); }
+		
+		/** Does literal j continue past the characters pre, which it begins 
+		 *  with? */
+		bool continues(unsigned long j, const std::string& pre) const {
+			if ( sets[j] ) return pre.empty();
+			return ls[j].size() > pre.size() && ls[j].compare(0, pre.size(), pre) == 0;
+		}
+		
+		/** May literal j match input beginning with c? */
+		bool begins(unsigned long j, char c) const {
+			return sets[j] ? ls[j].find(c) != std::string::npos : ls[j][0] == c;
+		}
+
+		std::vector<std::string> ls;	/**< The literals, in order (the 
+		                            	 *   characters of each class) */
+		std::vector<bool> sets;			/**< Which literals are classes */
+		std::vector<node> nodes;		/**< Nodes of the trie; the root is first */
+		unsigned long width;			/**< Length of the longest literal */
+
+	private:
+		/** Gets the characters of a class which is not negated (or Unicode) */
+		static std::string chars(const ast::range_matcher& m) {
+			std::string cs;
+			if ( m.neg || m.utf8 ) return cs;
+			for (auto it = m.rs.begin(); it != m.rs.end(); ++it) {
+				for (char32_t c = it->from; c <= it->to; ++c) {
+					if ( c != '\0' && cs.find(char(c)) == std::string::npos ) cs += char(c);
+					if ( cs.size() > max_set ) return cs;
 				}
 			}
-			out << " )";
-			
-			--tabs;
+			return cs;
+		}
+		
+		/** Adds the characters [it, end) below node n, for literal i */
+		void add(unsigned long n, std::string::const_iterator it, 
+				std::string::const_iterator end, unsigned long i) {
+			for (; it != end; ++it) {
+				n = child(n, *it);
+				nodes[n].least = std::min(nodes[n].least, i);
+			}
+			//a later copy of a literal can never match
+			if ( nodes[n].end == none ) nodes[n].end = i;
+		}
+		
+		/** Gets the child of node n for character c, adding it if needed */
+		unsigned long child(unsigned long n, char c) {
+			for (auto it = nodes[n].next.begin(); it != nodes[n].next.end(); ++it) {
+				if ( it->first == c ) return it->second;
+			}
+			nodes.push_back(node());
+			nodes[n].next.push_back(std::make_pair(c, nodes.size() - 1));
+			return nodes.size() - 1;
+		}
+	}; /* class keyword_trie */
+
+	/** Gets properties of matchers needed to generate flat code. */
+	class flat_props : ast::visitor {
+	public:
+		flat_props() {}
+
+		void visit(ast::char_matcher& m) { rVal = true; }
+		void visit(ast::str_matcher& m) { rVal = ! m.s.empty(); }
+		void visit(ast::range_matcher& m) { rVal = m.neg || ! m.rs.empty(); }
+		void visit(ast::rule_matcher& m) { rVal = true; }
+		void visit(ast::any_matcher& m) { rVal = true; }
+		void visit(ast::empty_matcher& m) { rVal = false; }
+
+		void visit(ast::action_matcher& m) {
+			rVal = false;
+			if ( m.a.find("psStart") != std::string::npos ) start = true;
+		}
+		
+		void visit(ast::opt_matcher& m) {
+			m.m->accept(this);
+			rVal = false;
+		}
+
+		void visit(ast::many_matcher& m) {
+			m.m->accept(this);
+			rVal = false;
+		}
+
+		void visit(ast::some_matcher& m) {
+			m.m->accept(this);
+		}
+
+		void visit(ast::seq_matcher& m) {
+			//nested sequences bind their own psStart
+			bool f = false, st = start;
+			for (auto it = m.ms.begin(); it != m.ms.end(); ++it) {
+				(*it)->accept(this);
+				f |= rVal;
+			}
+			rVal = f;
+			start = st;
+		}
+		
+		void visit(ast::alt_matcher& m) {
+			bool f = ! m.ms.empty();
+			for (auto it = m.ms.begin(); it != m.ms.end(); ++it) {
+				(*it)->accept(this);
+				f &= rVal;
+			}
+			rVal = f;
+		}
+
+		void visit(ast::look_matcher& m) {
+			//lookaheads bind their own psStart
+			bool st = start;
+			m.m->accept(this);
+			start = st;
+		}
+
+		void visit(ast::not_matcher& m) {
+			//lookaheads bind their own psStart
+			bool st = start;
+			m.m->accept(this);
+			rVal = true;
+			start = st;
+		}
+
+		void visit(ast::capt_matcher& m) {
+			m.m->accept(this);
+		}
+
+		void visit(ast::cut_matcher& m) { rVal = false; }
+
+		/** Can the matcher fail? */
+		bool fails(ast::matcher& m) {
+			start = false;
+			m.accept(this);
+			return rVal;
+		}
+
+		/** Does a semantic action in the sequence refer to the psStart it 
+		 *  binds? */
+		bool binds_start(ast::seq_matcher& m) {
+			start = false;
+			for (auto it = m.ms.begin(); it != m.ms.end(); ++it) {
+				(*it)->accept(this);
+			}
+			return start;
+		}
+		
+	private:
+		bool rVal;	/**< Can the current matcher fail? */
+		bool start;	/**< Has an action referring to psStart been found? */
+	}; /* class flat_props */
+	
+	/** Code generation options for visitor::compiler */
+	struct compiler_options {
+		compiler_options() 
+			: memo(false), flat(false), parallel(false), profile(false), sax(false), 
+			  cst(false), stats(false), inline_size(16), state("parse::state") {}
+		
+		bool memo;	/**< Memoize all rules, not just those annotated `%memo` */
+		bool flat;	/**< Generate flat code using gotos, rather than nested 
+		          	 *   lambdas */
+		bool parallel;	/**< Generate a parse_parallel() driver for the first 
+		              	 *   rule, which matches records on multiple threads */
+		bool profile;	/**< Record the calls, failures, input consumed and time 
+		             	 *   of each rule, and generate dump_profile() */
+		bool sax;	/**< Generate untyped rules without semantic actions, 
+		         	 *   reporting each rule matched to a handler (see 
+		         	 *   parse::sax()) */
+		bool cst;	/**< Record each rule matched as a node of the syntax tree 
+		         	 *   of the parser state (see parse::cst()) */
+		bool stats;	/**< Count the position resets of each rule in the 
+		           	 *   statistics of the parser state, and generate 
+		           	 *   dump_stats() (see parse::state_stats) */
+		unsigned long inline_size;	/**< Largest size of rule to splice into its 
+		                          	 *   callers (0 for none; see inlining) */
+		std::string state;	/**< Type of parser state the rules take, such as 
+		                  	 *   parse::unchecked_state */
+	}; /* struct compiler_options */
+	
+	/** Code generator for Egg matcher ASTs */
+	class compiler : ast::visitor {
+	public:
+		compiler(std::string name, std::ostream& out = std::cout, 
+				compiler_options opts = compiler_options()) 
+			: name(name), out(out), opts(opts), tabs(2), labels(0), fail(0), captures(false) {}
+
+		void visit(ast::char_matcher& m) {
+			test("parse::matches<\'" + strings::escape(m.c) + "\'>(ps)");
+		}
+
+		void visit(ast::str_matcher& m) {
+			if ( m.s.empty() ) {
+				succeed();
+			} else if ( m.s.size() == 1 ) {
+				test("parse::matches<\'" + strings::escape(m.s[0]) + "\'>(ps)");
+			} else {
+				//compare against input buffer in bulk
+				test("parse::literal(ps, " + str_literal(m.s) + ", " 
+						+ std::to_string(m.s.size()) + ")");
+			}
+		}
+
+		void visit(ast::range_matcher& m) {
+			if ( m.utf8 ) {
+				//decodes only characters past ASCII
+				test("parse::in_codes<" + codes(m) + ">(ps)");
+			} else if ( char_class_list::tabled(m) ) {
+				//single table lookup
+				test("parse::in_set<psSet" + std::to_string(classes.index(m)) + ">(ps)");
+			} else if ( m.neg ) {
+				//[^] matches any character
+				test("parse::any(ps)");
+			} else if ( m.rs.empty() ) {
+				succeed();
+			} else {
+				test("parse::matches<\'" + strings::escape(m.rs.front().to) + "\'>(ps)");
+			}
 		}
 
 		void visit(ast::rule_matcher& m) {
-			out << m.rule << "(ps)";
-			if ( ! m.var.empty() ) { out << "(" << m.var << ")"; }
+			if ( inl.inlined(m.rule) ) { inl.body(m.rule).accept(this); return; }
+			
+			if ( opts.sax ) test(m.rule + "(ps, psHandler)");
+			else if ( m.var.empty() ) test(m.rule + "(ps)");
+			else test(m.rule + "(ps)(" + m.var + ")");
 		}
 
 		void visit(ast::any_matcher& m) {
-			out << "parse::any(ps)";
+			test("parse::any(ps)");
 		}
 
 		void visit(ast::empty_matcher& m) {
-			out << "true";
+			succeed();
 		}
 
 		void visit(ast::action_matcher& m) {
+			//SAX parsers have no semantic actions
+			if ( opts.sax ) { succeed(); return; }
+			
+			//views the captured string in place only if the action reads it
+			std::string a = m.a;
+			if ( captures && variable_list::uses_capture(m) ) {
+				a = " psCapture = ps.view(psCatch, psCatchLen);" + a;
+			}
+			
+			if ( opts.flat ) {
+				//runs action code in its own scope
+				out << std::string(tabs, '\t') << "{" << a << "}" << '\n';
+				return;
+			}
+			
 			//runs action code with all variables bound, then returns true
-			out << "[&]() {" << m.a << " return true; }()";
+			out << "[&]() {" << a << " return true; }()";
 		}
 
 		void visit(ast::opt_matcher& m) {
+			if ( opts.flat ) { flat(m); return; }
+
 			//runs matcher, returns true regardless
 			out << "[&]() { ";
 			m.m->accept(this);
@@ -218,38 +637,71 @@ namespace visitor {
 		}
 
 		void visit(ast::many_matcher& m) {
+			//scan character classes in bulk
+			ast::matcher_ptr t = spliced(m.m);
+			if ( tabled(t) || coded(t) ) {
+				const ast::range_matcher& r = *ast::as_ptr<ast::range_matcher>(t);
+				std::string e = r.utf8 
+					? "parse::many_in_codes<" + codes(r) + ">(ps)"
+					: "parse::many_in_set<psSet" + std::to_string(classes.index(r)) + ">(ps)";
+				if ( opts.flat ) out << std::string(tabs, '\t') << e << ";" << '\n';
+				else out << e;
+				return;
+			}
+
+			if ( opts.flat ) { flat_many(*m.m); return; }
+
 			std::string indent(tabs, '\t');
 			++tabs;
 
 			//runs matcher as many times as it will match
 			out << "[&]() { while ( ";
 			m.m->accept(this);
-			out << " )" << std::endl 
-			    << indent << "\t;" << std::endl
+			out << " )" << '\n' 
+			    << indent << "\t;" << '\n'
 			    << indent << "return true; }()";
 			
 			--tabs;
 		}
 
 		void visit(ast::some_matcher& m) {
+			//scan character classes in bulk
+			ast::matcher_ptr t = spliced(m.m);
+			if ( tabled(t) || coded(t) ) {
+				const ast::range_matcher& r = *ast::as_ptr<ast::range_matcher>(t);
+				test(r.utf8 
+					? "parse::some_in_codes<" + codes(r) + ">(ps)"
+					: "parse::some_in_set<psSet" + std::to_string(classes.index(r)) + ">(ps)");
+				return;
+			}
+
+			if ( opts.flat ) {
+				//match once, then as many times as possible
+				m.m->accept(this);
+				flat_many(*m.m);
+				return;
+			}
+
 			std::string indent(tabs, '\t');
 			++tabs;
 			
 			//runs matcher at least once, then ast many times as it will match
 			out << "[&]() { if ( ";
 			m.m->accept(this);
-			out << " ) {" << std::endl
+			out << " ) {" << '\n'
 				<< indent << "\twhile ( ";
 			m.m->accept(this);
-			out << " )" << std::endl
-				<< indent << "\t\t;" << std::endl
-				<< indent << "\treturn true;" << std::endl
+			out << " )" << '\n'
+				<< indent << "\t\t;" << '\n'
+				<< indent << "\treturn true;" << '\n'
 				<< indent << "} else { return false; } }()";
 
 			--tabs;
 		}
 		
 		void visit(ast::seq_matcher& m) {
+			if ( opts.flat ) { flat(m); return; }
+
 			//empty sequence bad form, but always matches
 			if ( m.ms.empty() ) {
 				out << "true";
@@ -259,24 +711,36 @@ namespace visitor {
 			std::string indent(++tabs, '\t');
 
 			//bind all variables but psStart
-			out << "[&]() { " << std::endl
-				<< indent << "parse::ind psStart = ps.pos;" << std::endl
+			out << "[&]() { " << '\n'
+				<< indent << "parse::ind psStart = ps.pos;" << '\n'
+				<< mark(indent)
 				<< indent << "if ( ";
 
-			//test that all matchers match
+			//test that all matchers match, testing runs of fixed-width 
+			//terminals against a window of the input at once
 			auto it = m.ms.begin();
-			(*it)->accept(this);
-			++it;
 			while ( it != m.ms.end() ) {
-				out << std::endl
-					<< indent << "\t&& ";
-				(*it)->accept(this);
-				++it;
+				if ( it != m.ms.begin() ) out << '\n' << indent << "\t&& ";
+				auto e = run_end(it, m.ms.end());
+				if ( e == it ) { (*it)->accept(this); ++it; continue; }
+				
+				//the run's matchers are tested again one-by-one if it fails, 
+				//to record the expected terminal
+				out << "( [&]() {" << '\n'
+					<< indent << "\t\t" << run(it, e, indent + "\t\t") << " return true; }" << '\n'
+					<< indent << "\t\treturn false; }()" << '\n'
+					<< indent << "\t|| ( ";
+				for (auto jt = it; jt != e; ++jt) {
+					if ( jt != it ) out << " && ";
+					(*jt)->accept(this);
+				}
+				out << " ) )";
+				it = e;
 			}
 
 			//match if so, reset otherwise
-			out << " ) { return true; }" << std::endl
-				<< indent << "else { ps.pos = psStart; return false; } }()";
+			out << " ) { return true; }" << '\n'
+				<< indent << "else { " << count_reset("psStart") << "ps.pos = psStart;" << unwind() << " return false; } }()";
 
 			--tabs;
 		}
@@ -284,7 +748,20 @@ namespace visitor {
 		void visit(ast::alt_matcher& m) {
 			//empty alternation bad form, but always matches
 			if ( m.ms.empty() ) {
-				out << "true";
+				succeed();
+				return;
+			}
+
+			//match alternations of literals in one pass over the input
+			if ( keywords(m) ) return;
+
+			//skip alternatives which cannot match the next character
+			if ( dispatch(m) ) return;
+
+			if ( opts.flat ) {
+				std::vector<unsigned long> as;
+				for (unsigned long i = 0; i < m.ms.size(); ++i) as.push_back(i);
+				flat_alts(m, as, std::vector<std::string>());
 				return;
 			}
 
@@ -297,7 +774,7 @@ namespace visitor {
 			(*it)->accept(this);
 			++it;
 			while ( it != m.ms.end() ) {
-				out << std::endl
+				out << '\n'
 					<< indent << "|| ";
 				(*it)->accept(this);
 				++it;
@@ -308,156 +785,1164 @@ namespace visitor {
 		}
 
 		void visit(ast::look_matcher& m) {
+			if ( opts.flat ) { flat(m); return; }
+
 			std::string indent(++tabs, '\t');
 
 			//bind all variables but psStart
-			out << "[&]() {" << std::endl
-				<< indent << "parse::ind psStart = ps.pos;" << std::endl
+			out << "[&]() {" << '\n'
+				<< indent << "parse::ind psStart = ps.pos;" << '\n'
+				<< mark(indent)
 				<< indent << "if ( ";
 			//match iff contained matcher matches, always reset
 			m.m->accept(this);
-			out << " ) { ps.pos = psStart; return true; }" << std::endl
-				<< indent << "else { ps.pos = psStart; return false; } }()";
+			out << " ) { " << count_reset("psStart") << "ps.pos = psStart;" << unwind() << " return true; }" << '\n'
+				<< indent << "else { " << count_reset("psStart") << "ps.pos = psStart;" << unwind() << " return false; } }()";
 
 			--tabs;
 		}
 
 		void visit(ast::not_matcher& m) {
+			if ( opts.flat ) { flat(m); return; }
+
 			std::string indent(++tabs, '\t');
 
-			//bind all variables but psStart
-			out << "[&]() {" << std::endl
-				<< indent << "parse::ind psStart = ps.pos;" << std::endl
+			//bind all variables but psStart; failures inside aren't errors
+			out << "[&]() {" << '\n'
+				<< indent << "parse::ind psStart = ps.pos;" << '\n'
+				<< mark(indent)
+				<< indent << "ps.mute();" << '\n'
 				<< indent << "if ( ";
 			//match iff contained matcher fails, always reset
 			m.m->accept(this);
-			out << " ) { ps.pos = psStart; return false; }" << std::endl
-				<< indent << "else { ps.pos = psStart; return true; } }()";
+			out << " ) { " << count_reset("psStart") << "ps.pos = psStart;" << unwind() << " ps.unmute(); return false; }" << '\n'
+				<< indent << "else { " << count_reset("psStart") << "ps.pos = psStart;" << unwind() << " ps.unmute(); return true; } }()";
 
 			--tabs;
 		}
 
 		void visit(ast::capt_matcher& m) {
+			//SAX parsers have no semantic actions to read captures
+			if ( opts.sax ) { m.m->accept(this); return; }
+			if ( opts.flat ) { flat(m); return; }
+
 			std::string indent(++tabs, '\t');
 
 			//bind all variables
-			out << "[&]() {" << std::endl
-				<< indent << "psCatch = ps.pos;" << std::endl
+			out << "[&]() {" << '\n'
+				<< indent << "psCatch = ps.pos;" << '\n'
 				<< indent << "if ( ";
 			//match iff contained matcher matches
 			m.m->accept(this);
-			out << " ) {" << std::endl
-				<< indent << "\tpsCatchLen = ps.pos - psCatch;" << std::endl
-				<< indent << "\tpsCapture = ps.string(psCatch, psCatchLen);" << std::endl
-				<< indent << "\treturn true;" << std::endl
-				<< indent << "} else {" << std::endl
-				<< indent << "\tpsCatchLen = 0;" << std::endl
-				<< indent << "\tpsCapture = std::string(\"\");" << std::endl
-				<< indent << "\treturn false;" << std::endl
+			out << " ) {" << '\n'
+				<< indent << "\tpsCatchLen = ps.pos - psCatch;" << '\n'
+				<< indent << "\treturn true;" << '\n'
+				<< indent << "} else {" << '\n'
+				<< indent << "\tpsCatchLen = 0;" << '\n'
+				<< indent << "\treturn false;" << '\n'
 				<< indent << "} }()";
 
 			--tabs;
 		}
 
+		void visit(ast::cut_matcher& m) {
+			//forgets input (and memoized results) before the current position
+			if ( opts.flat ) out << std::string(tabs, '\t') << "ps.forgetTo(ps.pos);" << '\n';
+			else out << "[&ps]() { ps.forgetTo(ps.pos); return true; }()";
+		}
+
 		void compile(ast::grammar_rule& r) {
-			bool typed = ! r.type.empty();
+			//SAX parsers leave out rule types
+			std::string rtype = opts.sax ? "" : r.type;
+			bool typed = ! rtype.empty();
+			std::string type = typed ? rtype : "parse::value";
+			//left-recursive rules grow a seed in the memo table; the other 
+			//rules in their cycles depend on the seed, so aren't memoized
+			bool grow = lr.leader(r.name);
+			bool memo = grow || ( ( opts.memo || r.annotated("memo") ) 
+			                      && ! lr.involved(r.name) );
+			std::string id = std::to_string(ids[r.name]);
+			rule_id = id;
+
+			//warn on unrecognized annotations
+			for (auto it = r.annotations.begin(); it != r.annotations.end(); ++it) {
+				if ( *it == "noinline" ) continue;
+				if ( *it != "memo" ) {
+					std::cerr << "Warning: unknown annotation %" << *it 
+					          << " on rule " << r.name << std::endl;
+				} else if ( ! memo ) {
+					std::cerr << "Warning: not memoizing rule " << r.name 
+					          << ", which is part of a left-recursive cycle" << std::endl;
+				}
+			}
 
-			//print prototype
-			out << "\tparse::result<" << r.type << "> " << r.name << "(parse::state& ps) {" << std::endl
+			//print prototype; profiled, SAX, and CST rules are wrapped by a 
+			//function which records or reports each call
+			std::string fn = opts.profile || opts.sax || opts.cst ? "psRule_" + r.name : r.name;
+			if ( opts.sax ) {
+				out << "\ttemplate<typename psH>" << '\n'
+					<< "\tparse::result<> " << fn << "(psState& ps, psH& psHandler) {" << '\n';
+			} else {
+				out << "\tparse::result<" << rtype << "> " << fn << "(psState& ps) {" << '\n';
+			}
+			out
 			//setup return point
-				<< "\t\tparse::ind psStart = ps.pos;" << std::endl
+				<< "\t\tparse::ind psStart = ps.pos;" << '\n'
 				;
+			//check for memoized result (with its subtree, for CST rules)
+			std::string tree = opts.cst ? "ps.tree, psNodes, " : "";
+			if ( memo ) {
+				if ( opts.cst ) out << mark("\t\t");
+				out << "\t\tparse::result<" << rtype << "> psMemo;" << '\n'
+					<< "\t\tif ( ps.recall(" << id << ", psMemo" << ( opts.cst ? ", ps.tree" : "" ) 
+					                       << ") ) return psMemo;" << '\n'
+					<< "\t\tparse::ind psWatch = ps.watch();" << '\n'
+					;
+			}
+			//start growing the seed from a failure; each iteration matches the 
+			//rule again, with the left-recursive calls recalling the last seed
+			std::string indent("\t\t");
+			if ( grow ) {
+				out << '\n'
+					<< "\t\t//grow the left-recursive seed until it stops getting longer" << '\n'
+					<< "\t\tps.memoize(" << id << ", psStart, " << tree << "parse::fail<" << type << ">());" << '\n'
+					<< "\t\tparse::ind psGrown = psStart;" << '\n'
+					<< "\t\twhile ( true ) {" << '\n'
+					<< "\t\t\tparse::result<" << rtype << "> psSeed = [&]() -> parse::result<" << rtype << "> {" << '\n'
+					;
+				indent = "\t\t\t\t";
+				tabs += 2;
+			}
 			//setup return variable
-			if ( typed ) out << "\t\t" << r.type << " psVal;" << std::endl;
-			out << std::endl;
+			if ( typed ) out << indent << rtype << " psVal{};" << '\n';
+			out << '\n';
 
-			//setup bound variables
-			std::map<std::string, std::string> vs = vars.list(r);
+			//setup bound variables (SAX parsers have no actions to bind them)
+			std::map<std::string, std::string> vs;
+			if ( ! opts.sax ) vs = vars.list(r);
+			captures = vs.count("psCapture") > 0;
 			for (auto it = vs.begin(); it != vs.end(); ++it) {
-				out << "\t\t" << it->second << " " << it->first << ";" << std::endl;
+				out << indent << it->second << " " << it->first << ";" << '\n';
 			}
-			out << std::endl;
+			out << '\n';
 
 			//apply matcher
-			out << "\t\tif ( ";
-			r.m->accept(this);
-			out << " ) { return parse::match(" 
-					<< (typed? "psVal" : "parse::val") << "); }" << std::endl
-				<< "\t\telse { return parse::fail<"
-					<< (typed? r.type : "parse::value") << ">(); }" << std::endl
-				<< std::endl
-				;
+			std::string psMatch = std::string("parse::match(") 
+					+ (typed? "std::move(psVal)" : "parse::val") + ")";
+			std::string psFail = "parse::fail<" + type + ">()";
+			if ( memo && ! grow ) {
+				psMatch = "ps.memoize(" + id + ", psStart, psWatch, " + tree + psMatch + ")";
+				psFail = "ps.memoize(" + id + ", psStart, psWatch, " + tree + psFail + ")";
+			}
+			if ( opts.flat ) {
+				//run matcher, jumping to the failure label if it fails
+				labels = 0;
+				fail = label();
+				r.m->accept(this);
+				out << indent << "return " << psMatch << ";" << '\n';
+				if ( props.fails(*r.m) ) {
+					out << indent.substr(1) << "psFail" << fail << ":" << '\n'
+						<< indent << count_reset("psStart") << "ps.pos = psStart;" << '\n'
+						<< indent << "return " << psFail << ";" << '\n';
+				}
+				if ( ! grow ) out << '\n';
+			} else {
+				out << indent << "if ( ";
+				r.m->accept(this);
+				out << " ) { return " << psMatch << "; }" << '\n'
+					<< indent << "else { return " << psFail << "; }" << '\n'
+					;
+				if ( ! grow ) out << '\n';
+			}
+
+			//keep the seed while it gets longer, then return the longest, 
+			//noting the input examined by the attempt to grow it further
+			if ( grow ) {
+				tabs -= 2;
+				out << "\t\t\t}();" << '\n'
+					<< "\t\t\tif ( ! psSeed || ps.pos <= psGrown ) break;" << '\n'
+					<< "\t\t\tpsGrown = ps.pos;" << '\n'
+					<< "\t\t\tps.memoize(" << id << ", psStart, " << tree << "std::move(psSeed));" << '\n'
+					<< "\t\t\tps.pos = psStart;" << unwind() << '\n'
+					<< "\t\t}" << '\n'
+					<< "\t\tps.pos = psStart;" << unwind() << '\n'
+					<< "\t\tps.recall(" << id << ", psMemo" << ( opts.cst ? ", ps.tree" : "" ) << ");" << '\n'
+					<< "\t\treturn ps.memoize(" << id << ", psStart, psWatch, " << tree << "std::move(psMemo));" << '\n'
+					<< '\n'
+					;
+			}
 
 			//close out method
-			out << "\t}" << std::endl
-				<< std::endl
+			out << "\t}" << '\n'
+				<< '\n'
 				;
+			
+			if ( opts.profile ) {
+				out << "\tparse::result<" << rtype << "> " << r.name << "(psState& ps) {" << '\n'
+					<< "\t\treturn parse::profile(psProfile[" << id << "], ps, &" << fn << ");" << '\n'
+					<< "\t}" << '\n'
+					<< '\n'
+					;
+			} else if ( opts.sax ) {
+				out << "\ttemplate<typename psH>" << '\n'
+					<< "\tparse::result<> " << r.name << "(psState& ps, psH& psHandler) {" << '\n'
+					<< "\t\treturn parse::sax(\"" << r.name << "\", ps, psHandler, &" << fn << "<psH>);" << '\n'
+					<< "\t}" << '\n'
+					<< '\n'
+					;
+			} else if ( opts.cst ) {
+				out << "\tparse::result<" << rtype << "> " << r.name << "(psState& ps) {" << '\n'
+					<< "\t\treturn parse::cst(" << id << ", ps, &" << fn << ");" << '\n'
+					<< "\t}" << '\n'
+					<< '\n'
+					;
+			}
 		}
 
 		/** Compiles a grammar to the output file. */
 		void compile(ast::grammar& g) {
+			//SAX rules are templates, so can't be profiled or run in parallel; 
+			//the parallel driver makes its own parse::state for each chunk
+			if ( opts.sax ) { opts.profile = false; opts.parallel = false; opts.cst = false; }
+			//CST rules are wrapped to build the tree, which the parallel 
+			//driver's parser states would discard
+			if ( opts.cst ) { opts.profile = false; opts.parallel = false; }
+			if ( opts.state != "parse::state" ) opts.parallel = false;
+			
 			//print pre-amble
-			out << "#pragma once" << std::endl
-				<< std::endl
-				<< "/* THE FOLLOWING HAS BEEN AUTOMATICALLY GENERATED BY THE EGG PARSER GENERATOR." << std::endl
-				<< " * DO NOT EDIT. */" << std::endl
-				<< std::endl
+			out << "#pragma once" << '\n'
+				<< '\n'
+				<< "/* THE FOLLOWING HAS BEEN AUTOMATICALLY GENERATED BY THE EGG PARSER GENERATOR." << '\n'
+				<< " * DO NOT EDIT. */" << '\n'
+				<< '\n'
 				;
 
 			//print pre-code
 			if ( ! g.pre.empty() ) {
-				out << "// {%" << std::endl
-					<< g.pre << std::endl
-					<< "// %}" << std::endl
-					<< std::endl
+				out << "// {%" << '\n'
+					<< g.pre << '\n'
+					<< "// %}" << '\n'
+					<< '\n'
 					;
 			}
 
-			//get needed includes
-			out << "#include <string>" << std::endl
-				<< "#include \"parse.hpp\"" << std::endl
-				<< std::endl
-				;
+			//get needed includes; the parser state only has statistics if 
+			//PARSE_STATS is defined before parse.hpp is first included
+			if ( opts.profile || opts.stats ) out << "#include <iostream>" << '\n';
+			out << "#include <string>" << '\n';
+			if ( opts.stats ) {
+				out << "#ifndef PARSE_STATS" << '\n'
+					<< "#define PARSE_STATS" << '\n'
+					<< "#endif" << '\n';
+			}
+			out << "#include \"parse.hpp\"" << '\n';
+			if ( opts.stats ) {
+				out << "#ifndef PARSE_STATE_STATS" << '\n'
+					<< "#error \"parse.hpp included without PARSE_STATS; define it for every file (-DPARSE_STATS)\"" << '\n'
+					<< "#endif" << '\n';
+			}
+			out << '\n';
 
 			//setup parser namespace
-			out << "namespace " << name << " {" << std::endl
-				<< std::endl
+			out << "namespace " << name << " {" << '\n'
+				<< '\n'
+				;
+
+			//name the parser state type, so callers can construct it
+			out << "\ttypedef " << opts.state << " psState;" << '\n'
+				<< '\n'
 				;
 
 			//pre-declare matchers
 			for (auto it = g.rs.begin(); it != g.rs.end(); ++it) {
 				ast::grammar_rule& r = **it;
-				out << "\tparse::result<" << r.type << "> " << r.name << "(parse::state&);" << std::endl;
+				if ( opts.sax ) {
+					out << "\ttemplate<typename psH>" << '\n'
+						<< "\tparse::result<> " << r.name << "(psState&, psH&);" << '\n';
+				} else {
+					out << "\tparse::result<" << r.type << "> " << r.name << "(psState&);" << '\n';
+				}
+			}
+			out << '\n';
+
+			//define character class tables
+			classes = char_class_list(g);
+			for (unsigned long i = 0; i < classes.tables.size(); ++i) {
+				const char_class_list::table& t = classes.tables[i];
+				out << "\tconstexpr parse::char_set psSet" << i << " = {{ " << std::hex;
+				for (unsigned j = 0; j < t.size(); ++j) {
+					if ( j > 0 ) out << ", ";
+					out << "0x" << t[j] << "ull";
+				}
+				out << std::dec << " }};" << '\n';
+			}
+			std::map<char_class_list::code_table, std::string> ranges;
+			for (unsigned long i = 0; i < classes.codes.size(); ++i) {
+				const char_class_list::code_table& t = classes.codes[i];
+				std::string& rs = ranges[t];
+				if ( t.empty() ) {
+					rs = "nullptr";
+				} else if ( rs.empty() ) {
+					//classes with the same members past ASCII share ranges
+					rs = "psRanges" + std::to_string(i);
+					out << "\tconstexpr parse::code_range " << rs << "[] = {" << std::hex;
+					for (unsigned long j = 0; j < t.size(); ++j) {
+						if ( j > 0 ) out << ",";
+						out << " { 0x" << (unsigned long)t[j].first 
+						    << ", 0x" << (unsigned long)t[j].second << " }";
+					}
+					out << std::dec << " };" << '\n';
+				}
+				out << "\tconstexpr parse::code_set psCodes" << i << " = { " << rs << ", " 
+				    << t.size() << ", " << str_literal(classes.names[i]) << " };" << '\n';
+			}
+			if ( ! classes.tables.empty() ) out << '\n';
+
+			//assign rule identifiers (used as memo table keys)
+			ids.clear();
+			for (auto it = g.rs.begin(); it != g.rs.end(); ++it) {
+				ids.insert(std::make_pair((*it)->name, ids.size()));
+			}
+
+			//name the rules of syntax tree nodes and statistics, indexed by 
+			//rule identifier
+			if ( opts.cst || opts.stats ) {
+				out << "\tconstexpr const char* psRuleNames[] = {" << '\n';
+				for (auto it = g.rs.begin(); it != g.rs.end(); ++it) {
+					out << "\t\t\"" << (*it)->name << "\"," << '\n';
+				}
+				out << "\t};" << '\n'
+					<< '\n'
+					;
+			}
+
+			//define rule profiles, indexed by rule identifier
+			if ( opts.profile ) {
+				out << "\tparse::rule_profile psProfile[] = {" << '\n';
+				for (auto it = g.rs.begin(); it != g.rs.end(); ++it) {
+					out << "\t\tparse::rule_profile(\"" << (*it)->name << "\")," << '\n';
+				}
+				out << "\t};" << '\n'
+					<< '\n'
+					;
 			}
-			out << std::endl;
 
 			//generate matching functions
 			vars = variable_list(g);
+			firsts = first_sets(g);
+			lr = left_recursion(g, firsts);
+			//memoized, profiled, SAX, and CST rules need their own functions
+			inl = inlining(g, opts.memo || opts.profile || opts.sax || opts.cst ? 0 : opts.inline_size);
 			for (auto it = g.rs.begin(); it != g.rs.end(); ++it) {
 				ast::grammar_rule& r = **it;
 				compile(r);
 			}
 
+			//generate parallel record driver for the start rule
+			if ( opts.parallel && ! g.rs.empty() ) {
+				const std::string& start = g.rs.front()->name;
+				out << "\t/** Matches the records of the input, each ending with delim, by " << '\n'
+					<< "\t *  running " << start << " on chunks of them in parallel; see " << '\n'
+					<< "\t *  parse::parallel() */" << '\n'
+					<< "\ttemplate<typename F>" << '\n'
+					<< "\tbool parse_parallel(const parse::mapped_file& f, F each, char delim = '\\n', " << '\n'
+					<< "\t                    unsigned threads = 0, parse::ind chunk = 0) {" << '\n'
+					<< "\t\treturn parse::parallel(f, &" << start << ", each, delim, threads, chunk);" << '\n'
+					<< "\t}" << '\n'
+					<< '\n'
+					<< "\ttemplate<typename F>" << '\n'
+					<< "\tbool parse_parallel(const char* data, parse::ind len, F each, char delim = '\\n', " << '\n'
+					<< "\t                    unsigned threads = 0, parse::ind chunk = 0) {" << '\n'
+					<< "\t\treturn parse::parallel(data, len, &" << start << ", each, delim, threads, chunk);" << '\n'
+					<< "\t}" << '\n'
+					<< '\n'
+					;
+			}
+
+			//generate profile report
+			if ( opts.profile ) {
+				out << "\t/** Prints the profile of every rule called so far, sorted by time */" << '\n'
+					<< "\tvoid dump_profile(std::ostream& out = std::cerr) {" << '\n'
+					<< "\t\tparse::dump_profile(out, psProfile, " << g.rs.size() << ");" << '\n'
+					<< "\t}" << '\n'
+					<< '\n'
+					;
+			}
+
+			//generate statistics report
+			if ( opts.stats ) {
+				out << "\t/** Prints the statistics of a parser state, with the resets of its rules */" << '\n'
+					<< "\tvoid dump_stats(const psState& ps, std::ostream& out = std::cerr) {" << '\n'
+					<< "\t\tparse::dump_stats(out, ps.stats, psRuleNames, " << g.rs.size() << ");" << '\n'
+					<< "\t}" << '\n'
+					<< '\n'
+					;
+			}
+
 			//close parser namespace
-			out << "} /* namespace " << name << " */" << std::endl
-				<< std::endl
+			out << "} /* namespace " << name << " */" << '\n'
+				<< '\n'
 				;
 			
 			//print post-code
 			if ( ! g.post.empty() ) {
-				out << "// {%" << std::endl
-					<< g.post << std::endl
-					<< "// %}" << std::endl
-					<< std::endl
+				out << "// {%" << '\n'
+					<< g.post << '\n'
+					<< "// %}" << '\n'
+					<< '\n'
 					;
 			}
 		}
 		
 	private:
+		/** Gets a C++ character literal for c */
+		static std::string char_literal(char c) {
+			if ( c == '\n' || c == '\r' || c == '\t' || ( c >= ' ' && c <= '~' ) ) {
+				return "\'" + strings::escape(c) + "\'";
+			}
+			std::stringstream ss;
+			ss << "\'\\x" << std::hex << std::setw(2) << std::setfill('0') 
+			   << int((unsigned char)c) << "\'";
+			return ss.str();
+		}
+
+		/** Gets a C++ string literal for s */
+		static std::string str_literal(const std::string& s) {
+			std::string r = "\"";
+			for (auto it = s.begin(); it != s.end(); ++it) {
+				//escape '?' to avoid forming trigraphs
+				if ( *it == '?' ) r += "\\?";
+				else r += strings::escape(*it);
+			}
+			return r + "\"";
+		}
+
+		/** Gets the number of characters matched by a terminal which always 
+		 *  matches a fixed number of characters, or 0 if the matcher is not 
+		 *  one */
+		static unsigned long run_width(const ast::matcher_ptr& m) {
+			switch ( m->type() ) {
+			case ast::char_type: case ast::any_type: 
+				return 1;
+			case ast::str_type: 
+				return ast::as_ptr<ast::str_matcher>(m)->s.size();
+			case ast::range_type: {
+				const ast::range_matcher& r = *ast::as_ptr<ast::range_matcher>(m);
+				return ( ( r.neg || ! r.rs.empty() ) && ! r.utf8 ) ? 1 : 0;
+			} default: 
+				return 0;
+			}
+		}
+		
+		/** Gets the end of the run of at least two fixed-width terminals 
+		 *  starting at it, or it if there is no such run */
+		template<typename It>
+		static It run_end(It it, It end) {
+			It e = it;
+			while ( e != end && run_width(*e) > 0 ) ++e;
+			return ( e - it >= 2 ) ? e : it;
+		}
+		
+		/** Gets a test of the characters at psW[i] for a fixed-width terminal 
+		 *  (the window is '\0' past the end of input, which no terminal 
+		 *  matches) */
+		std::string run_test(const ast::matcher_ptr& m, unsigned long i) {
+			std::string c = "psW[" + std::to_string(i) + "]";
+			switch ( m->type() ) {
+			case ast::char_type: 
+				return c + " == " + char_literal(ast::as_ptr<ast::char_matcher>(m)->c);
+			case ast::any_type: 
+				return c + " != '\\0'";
+			case ast::str_type: {
+				const std::string& s = ast::as_ptr<ast::str_matcher>(m)->s;
+				return "std::memcmp(psW + " + std::to_string(i) + ", " + str_literal(s) 
+					+ ", " + std::to_string(s.size()) + ") == 0";
+			} default: {
+				const ast::range_matcher& r = *ast::as_ptr<ast::range_matcher>(m);
+				if ( char_class_list::tabled(r) ) {
+					return "psSet" + std::to_string(classes.index(r)) + ".contains(" + c + ")";
+				} else if ( r.neg ) {
+					return c + " != '\\0'";
+				}
+				return c + " == " + char_literal(r.rs.front().to);
+			}
+			}
+		}
+		
+		/** Gets the start of a statement which matches a run of fixed-width 
+		 *  terminals against a window of the input, leaving open the block 
+		 *  run if they match; the test is on a second line, at indent */
+		template<typename It>
+		std::string run(It it, It end, const std::string& indent) {
+			unsigned long w = 0;
+			std::string t;
+			for (; it != end; ++it) {
+				if ( ! t.empty() ) t += " && ";
+				t += run_test(*it, w);
+				w += run_width(*it);
+			}
+			std::string n = std::to_string(w);
+			return "const char* psW = ps.window(ps.pos, " + n + ");\n" 
+				+ indent + "if ( " + t + " ) { ps.examined(ps.pos + " + n + "); ps.pos += " + n + ";";
+		}
+		
+		/** Is the matcher a character class compiled to a table? */
+		static bool tabled(const ast::matcher_ptr& m) {
+			return m->type() == ast::range_type 
+				&& char_class_list::tabled(*ast::as_ptr<ast::range_matcher>(m));
+		}
+
+		/** Gets the matcher compiled in place of a matcher: the body of an 
+		 *  inlined rule for a call to it, or the matcher itself */
+		ast::matcher_ptr spliced(ast::matcher_ptr m) const {
+			while ( m->type() == ast::rule_type 
+					&& inl.inlined(ast::as_ptr<ast::rule_matcher>(m)->rule) ) {
+				m = &inl.body(ast::as_ptr<ast::rule_matcher>(m)->rule);
+			}
+			return m;
+		}
+
+		/** Is the matcher a Unicode character class? */
+		static bool coded(const ast::matcher_ptr& m) {
+			return m->type() == ast::range_type 
+				&& ast::as_ptr<ast::range_matcher>(m)->utf8;
+		}
+
+		/** Gets the template arguments of the matchers of a Unicode class: 
+		 *  the tables of its ASCII and other members */
+		std::string codes(const ast::range_matcher& m) {
+			return "psSet" + std::to_string(classes.index(m)) 
+				+ ", psCodes" + std::to_string(classes.code_index(m));
+		}
+
+		/** Compiles an alternation of nothing but character and string 
+		 *  literals (or small classes) to nested switches on the characters 
+		 *  of a window of the input (see keyword_trie), which read each 
+		 *  character at most once. The literal matched is the first which an 
+		 *  ordered choice would match, and the literals it would have tried 
+		 *  and failed to match are recorded as expected.
+		 *  @return false if the alternation is not all literals, in which 
+		 *          case no code has been generated */
+		bool keywords(ast::alt_matcher& m) {
+			keyword_trie t;
+			if ( ! t.build(m) ) return false;
+			
+			std::string w = "const char* psW = ps.window(ps.pos, " + std::to_string(t.width) + ");";
+			
+			if ( opts.flat ) {
+				std::string indent(tabs, '\t');
+				int p = label();
+				out << indent << "{" << '\n'
+					<< indent << "\t" << w << '\n';
+				trie_node(m, t, 0, "", keyword_trie::none, 
+				          "goto psDone" + std::to_string(p) + ";", indent + "\t");
+				out << indent << "\t}" << '\n'
+					<< indent << "}" << '\n'
+					<< indent.substr(1) << "psDone" << p << ": ;" << '\n';
+				return true;
+			}
+			
+			std::string indent(++tabs, '\t');
+			
+			out << "[&]() -> bool {" << '\n'
+				<< indent << w << '\n';
+			trie_node(m, t, 0, "", keyword_trie::none, "return true;", indent);
+			out << indent << "} }()";
+			
+			--tabs;
+			return true;
+		}
+		
+		/** Emits the code of keywords() for node n of the trie; the caller 
+		 *  closes the switch of the root.
+		 *  @param pre		The characters read to reach node n
+		 *  @param best		The first literal the input matches so far (or 
+		 *  				keyword_trie::none)
+		 *  @param done		The statement to run after a match */
+		void trie_node(ast::alt_matcher& m, const keyword_trie& t, unsigned long n, 
+				const std::string& pre, unsigned long best, const std::string& done, 
+				const std::string& indent) {
+			const keyword_trie::node& k = t.nodes[n];
+			unsigned long d = pre.size();
+			if ( k.end < best ) best = k.end;
+			
+			//read further only if a literal before the best may yet match
+			std::vector<std::pair<char, unsigned long>> next;
+			for (auto it = k.next.begin(); it != k.next.end(); ++it) {
+				if ( t.nodes[it->second].least < best ) next.push_back(*it);
+			}
+			if ( next.empty() ) {
+				out << indent << trie_end(m, t, best, std::to_string(d), pre, done) << '\n';
+				return;
+			}
+			
+			//if only one literal before the best may yet match, compare the 
+			//rest of it in bulk
+			unsigned long only = keyword_trie::none, count = 0;
+			for (unsigned long j = 0; j < t.ls.size() && j < best; ++j) {
+				if ( t.continues(j, pre) ) { only = j; ++count; }
+			}
+			if ( count == 1 && t.size(only) - d >= 2 ) {
+				std::string rest = str_literal(t.ls[only].substr(d));
+				std::string r = std::to_string(t.size(only) - d);
+				std::string w = std::to_string(d);
+				out << indent << "if ( std::memcmp(psW + " << w << ", " << rest << ", " << r << ") == 0 ) {" << '\n'
+					<< indent << "\t" << trie_end(m, t, only, std::to_string(t.size(only)), pre, done) << '\n'
+					<< indent << "}" << '\n'
+					<< indent << trie_end(m, t, best, "(std::mismatch(psW + " + w + ", psW + " 
+						+ std::to_string(t.size(only)) + ", " + rest + ").first - psW) + 1", 
+						pre, done) << '\n';
+				return;
+			}
+			
+			out << indent << "switch ( psW[" << d << "] ) {" << '\n';
+			for (auto it = next.begin(); it != next.end(); ++it) {
+				out << indent << "case " << char_literal(it->first) << ":" << '\n';
+				trie_node(m, t, it->second, pre + it->first, best, done, indent + "\t");
+			}
+			out << indent << "default:" << '\n'
+				<< indent << "\t" << trie_end(m, t, best, std::to_string(d + 1), pre, done) << '\n';
+			if ( d > 0 ) out << indent << "}" << '\n';
+		}
+		
+		/** Gets the statements of keywords() which match the literal best, 
+		 *  or fail if it is keyword_trie::none, after the input up to the 
+		 *  expression read has been examined; the literals before best which 
+		 *  may match the first character of pre are recorded as expected, as 
+		 *  an ordered choice would have tried them (if pre is empty, no 
+		 *  literal matches the first character, and the expected first 
+		 *  characters are recorded instead). */
+		std::string trie_end(ast::alt_matcher& m, const keyword_trie& t, 
+				unsigned long best, const std::string& read, const std::string& pre, 
+				const std::string& done) {
+			std::string s = "ps.examined(ps.pos + " + read + ");";
+			if ( pre.empty() ) {
+				s += " " + expect_firsts(m) + ";";
+			} else {
+				for (unsigned long j = 0; j < t.ls.size() && j < best; ++j) {
+					if ( ! t.begins(j, pre[0]) ) continue;
+					
+					//as recorded by the matcher of the literal
+					const std::string& l = t.ls[j];
+					if ( t.sets[j] ) {
+						const ast::range_matcher& r = *ast::as_ptr<ast::range_matcher>(m.ms[j]);
+						if ( char_class_list::tabled(r) ) {
+							s += " ps.expect(parse::expectation::set(psSet" 
+								+ std::to_string(classes.index(r)) + "));";
+						} else {
+							s += " ps.expect(parse::expectation::character(" 
+								+ char_literal(r.rs.front().to) + "));";
+						}
+					} else if ( l.size() == 1 ) {
+						s += " ps.expect(parse::expectation::character(" + char_literal(l[0]) + "));";
+					} else {
+						s += " ps.expect(parse::expectation::string(" + str_literal(l) 
+							+ ", " + std::to_string(l.size()) + "));";
+					}
+				}
+			}
+			
+			if ( best == keyword_trie::none ) {
+				if ( opts.flat ) return s + " goto psFail" + std::to_string(fail) + ";";
+				return s + " return false;";
+			}
+			return s + " ps.pos += " + std::to_string(t.size(best)) + "; " + done;
+		}
+		
+		/** Compiles an alternation so that it only tries the alternatives 
+		 *  which may match the next input character, according to their FIRST 
+		 *  sets. Where the alternatives are mostly disjoint, this is a switch 
+		 *  on the next character; otherwise each alternative is guarded by a 
+		 *  bit test against a 256-entry table.
+		 *  @return false if no alternative can be ruled out, in which case no 
+		 *          code has been generated */
+		bool dispatch(ast::alt_matcher& m) {
+			if ( m.ms.size() < 2 ) return false;
+
+			std::vector<first_set> fs;
+			for (auto it = m.ms.begin(); it != m.ms.end(); ++it) {
+				fs.push_back(firsts.of(**it));
+			}
+
+			//group characters by the alternatives that may match them
+			std::map<std::vector<unsigned long>, std::vector<char>> groups;
+			if ( fs.size() <= 64 ) {
+				//first by a bitmask of the alternatives, which is cheaper
+				std::map<unsigned long long, std::vector<char>> masks;
+				for (int c = -128; c < 128; ++c) {
+					unsigned long long mask = 0;
+					for (unsigned long i = 0; i < fs.size(); ++i) {
+						if ( fs[i].admits(c) ) mask |= 1ull << i;
+					}
+					masks[mask].push_back(c);
+				}
+				for (auto it = masks.begin(); it != masks.end(); ++it) {
+					std::vector<unsigned long> as;
+					for (unsigned long i = 0; i < fs.size(); ++i) {
+						if ( it->first & (1ull << i) ) as.push_back(i);
+					}
+					groups[as] = it->second;
+				}
+			} else {
+				std::vector<unsigned long> as;
+				for (int c = -128; c < 128; ++c) {
+					as.clear();
+					for (unsigned long i = 0; i < fs.size(); ++i) {
+						if ( fs[i].admits(c) ) as.push_back(i);
+					}
+					groups[as].push_back(c);
+				}
+			}
+
+			//nothing to gain if every alternative is always tried
+			if ( groups.size() == 1 && groups.begin()->first.size() == fs.size() ) return false;
+
+			//switch if that doesn't duplicate too much code, bit test otherwise
+			unsigned long cost = 0;
+			for (auto it = groups.begin(); it != groups.end(); ++it) cost += it->first.size();
+			if ( cost <= 2 * fs.size() ) {
+				dispatch_switch(m, groups);
+				return true;
+			} else if ( fs.size() <= 64 ) {
+				dispatch_table(m, fs);
+				return true;
+			}
+			return false;
+		}
+
+		/** Compiles an alternation to a switch on the next input character.
+		 *  @param groups	Matching alternatives (by index), mapped to the 
+		 *  				characters they are viable for */
+		void dispatch_switch(ast::alt_matcher& m, 
+				const std::map<std::vector<unsigned long>, std::vector<char>>& groups) {
+			//the largest group is the default case
+			auto dflt = groups.begin();
+			for (auto it = groups.begin(); it != groups.end(); ++it) {
+				if ( it->second.size() > dflt->second.size() ) dflt = it;
+			}
+
+			if ( opts.flat ) { flat_switch(m, groups, dflt); return; }
+
+			std::string indent(++tabs, '\t');
+
+			out << "[&]() -> bool {" << '\n'
+				<< indent << "switch ( ps[ps.pos] ) {" << '\n';
+			for (auto it = groups.begin(); it != groups.end(); ++it) {
+				if ( it == dflt ) continue;
+				case_labels(it->second, indent);
+				dispatch_case(m, it->first, indent);
+			}
+			out << indent << "default:" << '\n';
+			dispatch_case(m, dflt->first, indent);
+			out << indent << "} }()";
+
+			--tabs;
+		}
+
+		/** Prints the case labels of dispatch_switch() for a group of 
+		 *  characters */
+		void case_labels(const std::vector<char>& cs, const std::string& indent) {
+			out << indent;
+			for (unsigned long i = 0; i < cs.size(); ++i) {
+				if ( i > 0 && i % 8 == 0 ) out << '\n' << indent;
+				out << "case " << char_literal(cs[i]) << ": ";
+			}
+			out << '\n';
+		}
+
+		/** Compiles a case of dispatch_switch() which tries the given 
+		 *  alternatives */
+		void dispatch_case(ast::alt_matcher& m, const std::vector<unsigned long>& as, 
+				const std::string& indent) {
+			out << indent << "\treturn ";
+			if ( as.empty() ) {
+				out << expect_firsts(m);
+			} else {
+				++tabs;
+				for (unsigned long i = 0; i < as.size(); ++i) {
+					if ( i > 0 ) out << '\n' << indent << "\t\t|| ";
+					m.ms[as[i]]->accept(this);
+				}
+				--tabs;
+			}
+			out << ";" << '\n';
+		}
+
+		/** Compiles an alternation where each alternative is guarded by a 
+		 *  test of the next input character against a table of the 
+		 *  alternatives it may match. */
+		void dispatch_table(ast::alt_matcher& m, const std::vector<first_set>& fs) {
+			std::string indent(++tabs, '\t');
+
+			//build table of alternatives which may match each character
+			std::stringstream table;
+			table << indent << "static const unsigned long long psFirst[256] = {";
+			for (int c = 0; c < 256; ++c) {
+				unsigned long long mask = 0;
+				for (unsigned long i = 0; i < fs.size(); ++i) {
+					if ( fs[i].admits(char(c)) ) mask |= 1ull << i;
+				}
+				if ( c % 4 == 0 ) table << '\n' << indent << "\t";
+				table << "0x" << std::hex << mask << std::dec << "ull, ";
+			}
+			table << "};" << '\n'
+				<< indent << "unsigned long long psNext = psFirst[(unsigned char)ps[ps.pos]];" << '\n';
+
+			if ( opts.flat ) {
+				--tabs;
+				std::vector<unsigned long> as;
+				std::vector<std::string> guards;
+				for (unsigned long i = 0; i < fs.size(); ++i) {
+					std::stringstream guard;
+					if ( ! fs[i].all() ) guard << "psNext & 0x" << std::hex << (1ull << i) << "ull";
+					as.push_back(i);
+					guards.push_back(guard.str());
+				}
+				flat_alts(m, as, guards, table.str(), expect_firsts(m));
+				return;
+			}
+
+			out << "[&]() -> bool {" << '\n'
+				<< table.str()
+				<< indent << "return ";
+			for (unsigned long i = 0; i < fs.size(); ++i) {
+				if ( i > 0 ) out << '\n' << indent << "\t|| ";
+				if ( fs[i].all() ) {
+					m.ms[i]->accept(this);
+				} else {
+					out << "( ( psNext & 0x" << std::hex << (1ull << i) << std::dec << "ull ) && ";
+					m.ms[i]->accept(this);
+					out << " )";
+				}
+			}
+			out << '\n' << indent << "\t|| " << expect_firsts(m) << "; }()";
+
+			--tabs;
+		}
+
+		/** Gets an expression recording that one of the characters which may 
+		 *  begin the alternatives was expected, for when the next character 
+		 *  rules them all out; it is always false. */
+		std::string expect_firsts(ast::alt_matcher& m) {
+			parse::char_set cs = {{ 0, 0, 0, 0 }};
+			for (auto it = m.ms.begin(); it != m.ms.end(); ++it) {
+				first_set f = firsts.of(**it);
+				for (int c = 0; c < 256; ++c) {
+					if ( f.chars[c] ) cs.bits[c >> 6] |= 1ull << (c & 63);
+				}
+			}
+			return "ps.expect(parse::expectation::named(" 
+				+ str_literal(parse::expectation::describe(cs)) + "))";
+		}
+
+		/** Emits a matcher expression; in flat mode, as a statement which 
+		 *  jumps to the failure label if the expression is false */
+		void test(const std::string& e) {
+			if ( opts.flat ) {
+				out << std::string(tabs, '\t') 
+				    << "if ( ! " << e << " ) goto psFail" << fail << ";" << '\n';
+			} else {
+				out << e;
+			}
+		}
+
+		/** Emits a matcher which always matches without consuming input */
+		void succeed() {
+			if ( ! opts.flat ) out << "true";
+		}
+
+		/** Gets a new label number */
+		int label() { return ++labels; }
+
+		/** Emits a line declaring psNodes<l>, the size of the syntax tree at 
+		 *  a point the parser may backtrack to (with --cst only) */
+		std::string mark(const std::string& indent, int l = 0) const {
+			if ( ! opts.cst ) return "";
+			return indent + "parse::ind psNodes" + ( l ? std::to_string(l) : "" ) 
+				+ " = ps.tree.size();\n";
+		}
+
+		/** Emits a statement counting a reset of the input position back to 
+		 *  index `to` in the statistics of the current rule (with --stats 
+		 *  only) */
+		std::string count_reset(const std::string& to) const {
+			if ( ! opts.stats ) return "";
+			return "ps.stats.backtrack(" + rule_id + ", ps.pos - " + to + "); ";
+		}
+
+		/** Emits a statement removing the syntax tree nodes added since 
+		 *  psNodes<l> was declared, on backtracking (with --cst only) */
+		std::string unwind(int l = 0) const {
+			if ( ! opts.cst ) return "";
+			return " ps.tree.unwind(psNodes" + ( l ? std::to_string(l) : "" ) + ");";
+		}
+
+		/** Emits flat code for a matcher, which jumps to psFail<l> on failure 
+		 *  rather than the current failure label */
+		void flat_catch(ast::matcher& m, int l) {
+			int f = fail;
+			fail = l;
+			++tabs;
+			m.accept(this);
+			--tabs;
+			fail = f;
+		}
+
+		/** Emits flat code for a sequence; no position is restored on 
+		 *  failure, as that is done by the matcher handling the failure */
+		void flat(ast::seq_matcher& m) {
+			if ( ! props.binds_start(m) ) {
+				flat_items(m);
+				return;
+			}
+
+			std::string indent(tabs, '\t');
+			out << indent << "{" << '\n'
+				<< indent << "\tparse::ind psStart = ps.pos;" << '\n';
+			++tabs;
+			flat_items(m);
+			--tabs;
+			out << indent << "}" << '\n';
+		}
+		
+		/** Emits flat code for the matchers of a sequence, testing runs of 
+		 *  fixed-width terminals against a window of the input at once */
+		void flat_items(ast::seq_matcher& m) {
+			std::string indent(tabs, '\t');
+			auto it = m.ms.begin();
+			while ( it != m.ms.end() ) {
+				auto e = run_end(it, m.ms.end());
+				if ( e == it ) { (*it)->accept(this); ++it; continue; }
+				
+				//the run's matchers are tested again one-by-one if it fails, 
+				//to record the expected terminal
+				out << indent << "{" << '\n'
+					<< indent << "\t" << run(it, e, indent + "\t") << " }" << '\n';
+				tabs += 2;
+				out << indent << "\telse {" << '\n';
+				for (auto jt = it; jt != e; ++jt) (*jt)->accept(this);
+				tabs -= 2;
+				out << indent << "\t}" << '\n'
+					<< indent << "}" << '\n';
+				it = e;
+			}
+		}
+
+		/** Emits flat code for an optional matcher */
+		void flat(ast::opt_matcher& m) {
+			if ( ! props.fails(*m.m) ) { m.m->accept(this); return; }
+
+			std::string indent(tabs, '\t');
+			int l = label();
+			out << indent << "{" << '\n'
+				<< indent << "\tparse::ind psPos" << l << " = ps.pos;" << '\n'
+				<< mark(indent + '\t', l);
+			flat_catch(*m.m, l);
+			out << indent << "\tgoto psDone" << l << ";" << '\n'
+				<< indent << "psFail" << l << ":" << '\n'
+				<< indent << "\t" << count_reset("psPos" + std::to_string(l)) << "ps.pos = psPos" << l << ";" << unwind(l) << '\n'
+				<< indent << "psDone" << l << ": ;" << '\n'
+				<< indent << "}" << '\n';
+		}
+
+		/** Emits flat code to match m as many times as it will match */
+		void flat_many(ast::matcher& m) {
+			std::string indent(tabs, '\t');
+			out << indent << "for (;;) {" << '\n';
+
+			if ( ! props.fails(m) ) {
+				//never terminates, as in a lambda
+				++tabs;
+				m.accept(this);
+				--tabs;
+			} else {
+				int l = label();
+				out << indent << "\tparse::ind psPos" << l << " = ps.pos;" << '\n'
+					<< mark(indent + '\t', l);
+				flat_catch(m, l);
+				out << indent << "\tcontinue;" << '\n'
+					<< indent << "psFail" << l << ":" << '\n'
+					<< indent << "\t" << count_reset("psPos" + std::to_string(l)) << "ps.pos = psPos" << l << ";" << unwind(l) << '\n'
+					<< indent << "\tbreak;" << '\n';
+			}
+
+			out << indent << "}" << '\n';
+		}
+
+		/** Emits flat code for an alternation trying the given alternatives 
+		 *  in order, where those with a non-empty guard are only tried if it 
+		 *  holds.
+		 *  @param pre		Declarations to emit before the alternatives
+		 *  @param expect	Statement to run if every alternative fails */
+		void flat_alts(ast::alt_matcher& m, const std::vector<unsigned long>& as, 
+				const std::vector<std::string>& guards, const std::string& pre = "", 
+				const std::string& expect = "") {
+			//an alternative that can't fail always matches
+			if ( guards.empty() && ! props.fails(*m.ms[as.front()]) ) {
+				m.ms[as.front()]->accept(this);
+				return;
+			}
+
+			std::string indent(tabs, '\t');
+			int p = label();
+			out << indent << "{" << '\n'
+				<< pre
+				<< indent << "\tparse::ind psPos" << p << " = ps.pos;" << '\n'
+				<< mark(indent + '\t', p);
+			++tabs;
+			flat_chain(m, as, guards, p, expect);
+			--tabs;
+			out << indent << "}" << '\n'
+				<< indent.substr(1) << "psDone" << p << ": ;" << '\n';
+		}
+
+		/** Emits flat code trying the given alternatives in order (see 
+		 *  flat_alts()), restoring the input position to psPos<p> after each 
+		 *  that fails, and jumping to psDone<p> after one matches; if all 
+		 *  fail, runs the expect statement (if any) then fails. */
+		void flat_chain(ast::alt_matcher& m, const std::vector<unsigned long>& as, 
+				const std::vector<std::string>& guards, int p, 
+				const std::string& expect = "") {
+			std::string indent(tabs, '\t');
+			for (unsigned long i = 0; i < as.size(); ++i) {
+				ast::matcher& a = *m.ms[as[i]];
+				bool guarded = i < guards.size() && ! guards[i].empty();
+				bool fails = props.fails(a);
+
+				std::string in = indent;
+				if ( guarded ) {
+					out << indent << "if ( " << guards[i] << " ) {" << '\n';
+					in += '\t';
+					++tabs;
+				}
+				
+				if ( fails ) {
+					int l = label();
+					--tabs;
+					flat_catch(a, l);
+					++tabs;
+					out << in << "goto psDone" << p << ";" << '\n'
+						<< in.substr(1) << "psFail" << l << ":" << '\n'
+						<< in << count_reset("psPos" + std::to_string(p)) << "ps.pos = psPos" << p << ";" << unwind(p) << '\n';
+				} else {
+					a.accept(this);
+					out << in << "goto psDone" << p << ";" << '\n';
+				}
+				
+				if ( guarded ) {
+					--tabs;
+					out << indent << "}" << '\n';
+				} else if ( ! fails ) {
+					//later alternatives are unreachable
+					return;
+				}
+			}
+			if ( ! expect.empty() ) out << indent << expect << ";" << '\n';
+			out << indent << "goto psFail" << fail << ";" << '\n';
+		}
+
+		/** Emits flat code for dispatch_switch() */
+		void flat_switch(ast::alt_matcher& m, 
+				const std::map<std::vector<unsigned long>, std::vector<char>>& groups, 
+				std::map<std::vector<unsigned long>, std::vector<char>>::const_iterator dflt) {
+			std::string indent(tabs, '\t');
+			int p = label();
+			out << indent << "{" << '\n'
+				<< indent << "\tparse::ind psPos" << p << " = ps.pos;" << '\n'
+				<< mark(indent + '\t', p)
+				<< indent << "\tswitch ( ps[ps.pos] ) {" << '\n';
+			tabs += 2;
+			for (auto it = groups.begin(); it != groups.end(); ++it) {
+				if ( it == dflt ) continue;
+				case_labels(it->second, indent + "\t");
+				flat_chain(m, it->first, std::vector<std::string>(), p, 
+				           it->first.empty() ? expect_firsts(m) : "");
+			}
+			out << indent << "\tdefault:" << '\n';
+			flat_chain(m, dflt->first, std::vector<std::string>(), p, 
+			           dflt->first.empty() ? expect_firsts(m) : "");
+			tabs -= 2;
+			out << indent << "\t}" << '\n'
+				<< indent << "}" << '\n'
+				<< indent.substr(1) << "psDone" << p << ": ;" << '\n';
+		}
+
+		/** Emits flat code for a lookahead matcher */
+		void flat(ast::look_matcher& m) {
+			std::string indent(tabs, '\t');
+			out << indent << "{" << '\n'
+				<< indent << "\tparse::ind psStart = ps.pos;" << '\n'
+				<< mark(indent + '\t');
+			++tabs;
+			m.m->accept(this);
+			--tabs;
+			out << indent << "\t" << count_reset("psStart") << "ps.pos = psStart;" << unwind() << '\n'
+				<< indent << "}" << '\n';
+		}
+
+		/** Emits flat code for a negative lookahead matcher */
+		void flat(ast::not_matcher& m) {
+			std::string indent(tabs, '\t');
+			if ( ! props.fails(*m.m) ) {
+				//always fails
+				out << indent << "ps.mute();" << '\n';
+				m.m->accept(this);
+				out << indent << "ps.unmute();" << '\n'
+					<< indent << "goto psFail" << fail << ";" << '\n';
+				return;
+			}
+
+			//failures inside aren't errors
+			int l = label();
+			out << indent << "{" << '\n'
+				<< indent << "\tparse::ind psStart = ps.pos;" << '\n'
+				<< mark(indent + '\t')
+				<< indent << "\tps.mute();" << '\n';
+			flat_catch(*m.m, l);
+			out << indent << "\tps.unmute();" << '\n'
+				<< indent << "\tgoto psFail" << fail << ";" << '\n'
+				<< indent << "psFail" << l << ":" << '\n'
+				<< indent << "\t" << count_reset("psStart") << "ps.pos = psStart;" << unwind() << '\n'
+				<< indent << "\tps.unmute();" << '\n'
+				<< indent << "}" << '\n';
+		}
+
+		/** Emits flat code for a capturing matcher */
+		void flat(ast::capt_matcher& m) {
+			std::string indent(tabs, '\t');
+			bool fails = props.fails(*m.m);
+			int l = fails ? label() : fail;
+
+			out << indent << "psCatch = ps.pos;" << '\n';
+			--tabs;
+			flat_catch(*m.m, l);
+			++tabs;
+			out << indent << "psCatchLen = ps.pos - psCatch;" << '\n';
+			if ( fails ) {
+				out << indent << "goto psDone" << l << ";" << '\n'
+					<< indent.substr(1) << "psFail" << l << ":" << '\n'
+					<< indent << "psCatchLen = 0;" << '\n'
+					<< indent << "goto psFail" << fail << ";" << '\n'
+					<< indent.substr(1) << "psDone" << l << ": ;" << '\n';
+			}
+		}
+
 		std::string name;	/** Name of the grammar */
 		std::ostream& out;	/** Output stream to print to */
+		compiler_options opts;	/** Code generation options */
 		variable_list vars;	/** Holds grammar rule types */
+		first_sets firsts;	/** Holds FIRST sets of grammar rules */
+		left_recursion lr;	/** Finds left-recursive grammar rules */
+		inlining inl;		/** Chooses grammar rules to inline */
+		char_class_list classes;	/** Holds character class tables */
+		std::unordered_map<std::string, unsigned long> ids;
+							/** Rule identifiers by name */
 		int tabs;			/** Number of tabs for printer */
+		flat_props props;	/** Matcher properties for flat code */
+		int labels;			/** Number of labels generated in flat code */
+		int fail;			/** Label to jump to on failure in flat code */
+		bool captures;		/** Does an action of the current rule read psCapture? */
+		std::string rule_id;	/** Identifier of the current rule */
 	}; /* class compiler */
 	
 } /* namespace visitor */
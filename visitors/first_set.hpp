@@ -0,0 +1,263 @@
+#pragma once
+
+/*
+ * Copyright (c) 2013 Aaron Moss
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <bitset>
+#include <string>
+#include <unordered_map>
+
+#include "../ast.hpp"
+
+namespace visitor {
+
+	/** The FIRST set of a matcher: the characters which may begin a
+	 *  successful match, and whether the matcher may succeed without
+	 *  consuming any input. A matcher which is not nullable cannot succeed
+	 *  if the next input character is not in its FIRST set. */
+	class first_set {
+	public:
+		first_set() : chars(), nullable(false) {}
+
+		/** Can the matcher succeed when c is the next input character? */
+		bool admits(char c) const {
+			return nullable || chars[(unsigned char)c];
+		}
+
+		/** Can the matcher succeed regardless of the next input character? */
+		bool all() const { return nullable || chars.all(); }
+
+		/** Adds the characters from the given range */
+		first_set& operator += (const ast::char_range& r) {
+			for (char32_t c = r.from; c <= r.to && c < 0x100; ++c) { chars.set(c); }
+			return *this;
+		}
+
+		/** Adds the first characters of the UTF-8 encodings of the 
+		 *  codepoints in the given range */
+		void add_utf8(const ast::char_range& r) {
+			if ( r.from < 0x80 ) *this += ast::char_range(r.from, std::min<char32_t>(r.to, 0x7f));
+			if ( r.to < 0x80 ) return;
+			//the first byte of an encoding increases with the codepoint
+			unsigned char f = lead(std::max<char32_t>(r.from, 0x80)), t = lead(r.to);
+			for (unsigned c = f; c <= t; ++c) { chars.set(c); }
+		}
+
+		bool operator == (const first_set& o) const {
+			return nullable == o.nullable && chars == o.chars;
+		}
+
+		bool operator != (const first_set& o) const { return !(*this == o); }
+
+		std::bitset<256> chars;	/**< Characters which may begin a match */
+		bool nullable;			/**< May the matcher match the empty string? */
+
+	private:
+		/** Gets the first byte of the UTF-8 encoding of a non-ASCII 
+		 *  codepoint */
+		static unsigned char lead(char32_t c) {
+			if ( c < 0x800 ) return 0xc0 | (c >> 6);
+			if ( c < 0x10000 ) return 0xe0 | (c >> 12);
+			return 0xf0 | std::min<char32_t>(c >> 18, 4);
+		}
+	}; /* class first_set */
+
+	/** Computes FIRST sets for the matchers of a grammar.
+	 *  Semantic actions are treated as admitting any character, so that an
+	 *  alternative they begin is never skipped and its side effects are
+	 *  preserved. */
+	class first_sets : ast::visitor {
+	public:
+		first_sets() {}
+
+		/** Computes FIRST sets for all the rules of a grammar */
+		first_sets(ast::grammar& g) {
+			//start all rules at the empty set, then iterate to fixed point
+			for (auto it = g.rs.begin(); it != g.rs.end(); ++it) {
+				rules[(*it)->name] = first_set();
+			}
+
+			bool changed = true;
+			while ( changed ) {
+				changed = false;
+				for (auto it = g.rs.begin(); it != g.rs.end(); ++it) {
+					ast::grammar_rule& r = **it;
+					first_set f = of(*r.m);
+					if ( f != rules[r.name] ) {
+						rules[r.name] = f;
+						changed = true;
+					}
+				}
+			}
+		}
+
+		void visit(ast::char_matcher& m) {
+			rVal = first_set();
+			rVal.chars.set((unsigned char)m.c);
+		}
+
+		void visit(ast::str_matcher& m) {
+			rVal = first_set();
+			if ( m.s.empty() ) { rVal.nullable = true; }
+			else { rVal.chars.set((unsigned char)m.s[0]); }
+		}
+
+		void visit(ast::range_matcher& m) {
+			rVal = first_set();
+			if ( m.utf8 ) {
+				if ( m.neg ) {
+					//any codepoint not in the ranges, excluding '\0'
+					rVal += ast::char_range('\1', '\x7f');
+					rVal.add_utf8(ast::char_range(char32_t(0x80), char32_t(0x10ffff)));
+					for (auto it = m.rs.begin(); it != m.rs.end(); ++it) {
+						for (char32_t c = it->from; c <= it->to && c < 0x80; ++c) {
+							rVal.chars.reset(c);
+						}
+					}
+				} else {
+					for (auto it = m.rs.begin(); it != m.rs.end(); ++it) { rVal.add_utf8(*it); }
+				}
+				return;
+			}
+			for (auto it = m.rs.begin(); it != m.rs.end(); ++it) { rVal += *it; }
+			if ( m.neg ) {
+				//like any_matcher, the end-of-input '\0' doesn't match
+				rVal.chars.flip();
+				rVal.chars.reset(0);
+			} else if ( m.rs.empty() ) {
+				rVal.nullable = true;
+			}
+		}
+
+		void visit(ast::rule_matcher& m) {
+			auto it = rules.find(m.rule);
+			if ( it == rules.end() ) {
+				//unknown rule; assume anything
+				rVal = any_set();
+			} else {
+				rVal = it->second;
+			}
+		}
+
+		void visit(ast::any_matcher& m) {
+			//the end-of-input '\0' doesn't match
+			rVal = first_set();
+			rVal.chars.set();
+			rVal.chars.reset(0);
+		}
+
+		void visit(ast::empty_matcher& m) {
+			rVal = first_set();
+			rVal.nullable = true;
+		}
+
+		void visit(ast::action_matcher& m) {
+			rVal = any_set();
+		}
+
+		void visit(ast::opt_matcher& m) {
+			m.m->accept(this);
+			rVal.nullable = true;
+		}
+
+		void visit(ast::many_matcher& m) {
+			m.m->accept(this);
+			rVal.nullable = true;
+		}
+
+		void visit(ast::some_matcher& m) {
+			m.m->accept(this);
+		}
+
+		void visit(ast::seq_matcher& m) {
+			first_set f;
+			f.nullable = true;
+			for (auto it = m.ms.begin(); it != m.ms.end() && f.nullable; ++it) {
+				(*it)->accept(this);
+				f.chars |= rVal.chars;
+				f.nullable = rVal.nullable;
+			}
+			rVal = f;
+		}
+
+		void visit(ast::alt_matcher& m) {
+			first_set f;
+			if ( m.ms.empty() ) { f.nullable = true; }
+			for (auto it = m.ms.begin(); it != m.ms.end(); ++it) {
+				(*it)->accept(this);
+				f.chars |= rVal.chars;
+				f.nullable |= rVal.nullable;
+			}
+			rVal = f;
+		}
+
+		void visit(ast::look_matcher& m) {
+			//never consumes input
+			rVal = first_set();
+			rVal.nullable = true;
+		}
+
+		void visit(ast::not_matcher& m) {
+			//never consumes input
+			rVal = first_set();
+			rVal.nullable = true;
+		}
+
+		void visit(ast::capt_matcher& m) {
+			m.m->accept(this);
+		}
+
+		void visit(ast::cut_matcher& m) {
+			rVal = first_set();
+			rVal.nullable = true;
+		}
+
+		/** Gets the FIRST set of a matcher */
+		first_set of(ast::matcher& m) {
+			m.accept(this);
+			return rVal;
+		}
+
+		/** Gets the FIRST set of a grammar rule */
+		first_set of(const std::string& rule) {
+			auto it = rules.find(rule);
+			return it == rules.end() ? any_set() : it->second;
+		}
+
+	private:
+		/** FIRST set which may match anything */
+		static first_set any_set() {
+			first_set f;
+			f.chars.set();
+			f.nullable = true;
+			return f;
+		}
+
+		/** FIRST sets of grammar rules, by name */
+		std::unordered_map<std::string, first_set> rules;
+		/** The FIRST set to return for the current visit */
+		first_set rVal;
+	}; /* class first_sets */
+
+} /* namespace visitor */
+
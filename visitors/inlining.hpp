@@ -0,0 +1,209 @@
+#pragma once
+
+/*
+ * Copyright (c) 2013 Aaron Moss
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../ast.hpp"
+
+namespace visitor {
+
+	/** Chooses the grammar rules whose matchers the compiler splices into 
+	 *  their callers, rather than calling. A rule is inlined if it is small, 
+	 *  untyped, neither memoized nor annotated `%noinline`, cannot call 
+	 *  itself (directly or through other rules), and has no semantic 
+	 *  actions, captures, or bound variables, any of which would need the 
+	 *  rule's own scope. Its size is the number of matchers it contains, 
+	 *  counting the sizes of the rules it inlines in turn. */
+	class inlining : ast::visitor {
+	public:
+		inlining() : limit(0) {}
+		
+		/** Chooses the rules of a grammar to inline
+		 *  @param g		The grammar
+		 *  @param size		The largest size of rule to inline (0 for none)
+		 */
+		inlining(ast::grammar& g, unsigned long size) : limit(size) {
+			if ( size == 0 ) return;
+			
+			//find the calls, size, and scope needs of each rule
+			for (auto it = g.rs.begin(); it != g.rs.end(); ++it) {
+				ast::grammar_rule& r = **it;
+				facts& f = rules[r.name];
+				f.r = &r;
+				cur = &f;
+				r.m->accept(this);
+			}
+			
+			//rules which can reach themselves are recursive
+			index = 0;
+			for (auto it = g.rs.begin(); it != g.rs.end(); ++it) {
+				facts& f = rules[(*it)->name];
+				if ( ! f.visited ) connect(f);
+			}
+			
+			for (auto it = g.rs.begin(); it != g.rs.end(); ++it) {
+				const std::string& name = (*it)->name;
+				if ( inlinable(name) ) inlines.insert(name);
+			}
+		}
+		
+		void visit(ast::char_matcher& m) { ++cur->size; }
+		void visit(ast::str_matcher& m) { ++cur->size; }
+		void visit(ast::range_matcher& m) { ++cur->size; }
+		
+		void visit(ast::rule_matcher& m) {
+			cur->calls.push_back(m.rule);
+			if ( ! m.var.empty() ) cur->scoped = true;
+		}
+		
+		void visit(ast::any_matcher& m) { ++cur->size; }
+		void visit(ast::empty_matcher& m) { ++cur->size; }
+		void visit(ast::action_matcher& m) { cur->scoped = true; }
+		
+		void visit(ast::opt_matcher& m) { ++cur->size; m.m->accept(this); }
+		void visit(ast::many_matcher& m) { ++cur->size; m.m->accept(this); }
+		void visit(ast::some_matcher& m) { ++cur->size; m.m->accept(this); }
+		
+		void visit(ast::seq_matcher& m) {
+			++cur->size;
+			for (auto it = m.ms.begin(); it != m.ms.end(); ++it) (*it)->accept(this);
+		}
+		
+		void visit(ast::alt_matcher& m) {
+			++cur->size;
+			for (auto it = m.ms.begin(); it != m.ms.end(); ++it) (*it)->accept(this);
+		}
+		
+		void visit(ast::look_matcher& m) { ++cur->size; m.m->accept(this); }
+		void visit(ast::not_matcher& m) { ++cur->size; m.m->accept(this); }
+		void visit(ast::capt_matcher& m) { cur->scoped = true; m.m->accept(this); }
+		void visit(ast::cut_matcher& m) { ++cur->size; }
+		
+		/** Should calls to the rule be replaced by its matcher? */
+		bool inlined(const std::string& rule) const {
+			return inlines.count(rule) > 0;
+		}
+		
+		/** Gets the matcher of an inlined rule */
+		ast::matcher& body(const std::string& rule) const {
+			return *rules.find(rule)->second.r->m;
+		}
+		
+	private:
+		/** What is known about a rule */
+		struct facts {
+			facts() : r(0), size(0), scoped(false), recursive(false), counted(false), sum(0), 
+			          visited(false), stacked(false), index(0), low(0) {}
+			
+			/** Could the rule be inlined, if small enough? */
+			bool inlinable() const {
+				return r->type.empty() && ! r->annotated("memo") && ! r->annotated("noinline") 
+					&& ! scoped && ! recursive;
+			}
+			
+			ast::grammar_rule* r;				/**< The rule */
+			std::vector<std::string> calls;		/**< Rules it calls, once per call */
+			unsigned long size;					/**< Matchers it contains, not 
+			                   					 *   counting rule calls */
+			bool scoped;						/**< Does it need its own scope? */
+			bool recursive;						/**< Can it call itself? */
+			bool counted;						/**< Has sum been computed? */
+			unsigned long sum;					/**< Size including inlined calls */
+			bool visited;						/**< Has connect() visited it? */
+			bool stacked;						/**< Is it on the Tarjan stack? */
+			unsigned long index, low;			/**< Search index and low link */
+		}; /* struct facts */
+		
+		/** Tarjan's strongly connected components algorithm on the call 
+		 *  graph; the rules of components with more than one rule, or a rule 
+		 *  which calls itself, are recursive */
+		void connect(facts& v) {
+			v.visited = v.stacked = true;
+			v.index = v.low = index++;
+			stack.push_back(&v);
+			
+			bool self = false;
+			for (auto it = v.calls.begin(); it != v.calls.end(); ++it) {
+				auto jt = rules.find(*it);
+				if ( jt == rules.end() ) continue;
+				facts& w = jt->second;
+				if ( &w == &v ) self = true;
+				if ( ! w.visited ) {
+					connect(w);
+					v.low = std::min(v.low, w.low);
+				} else if ( w.stacked ) {
+					v.low = std::min(v.low, w.index);
+				}
+			}
+			
+			if ( v.low == v.index ) {
+				bool cyclic = self || stack.back() != &v;
+				facts* w;
+				do {
+					w = stack.back();
+					stack.pop_back();
+					w->stacked = false;
+					w->recursive = cyclic;
+				} while ( w != &v );
+			}
+		}
+		
+		/** Is the rule inlinable and small enough to inline? */
+		bool inlinable(const std::string& rule) {
+			auto it = rules.find(rule);
+			return it != rules.end() && it->second.inlinable() && total(it->second) <= limit;
+		}
+		
+		/** Gets the size of an inlinable rule, counting the rules it inlines 
+		 *  at their full size and other calls as one matcher */
+		unsigned long total(facts& f) {
+			if ( f.counted ) return f.sum;
+			f.counted = true;
+			f.sum = f.size;
+			//only non-recursive rules are expanded, so this terminates
+			for (auto it = f.calls.begin(); it != f.calls.end(); ++it) {
+				f.sum += inlinable(*it) ? total(rules[*it]) : 1;
+			}
+			return f.sum;
+		}
+		
+		/** The largest size of rule to inline */
+		unsigned long limit;
+		/** Facts about each rule, by name */
+		std::unordered_map<std::string, facts> rules;
+		/** The rules to inline */
+		std::unordered_set<std::string> inlines;
+		/** Facts about the rule being visited */
+		facts* cur;
+		/** Rules on the Tarjan stack */
+		std::vector<facts*> stack;
+		/** Next search index */
+		unsigned long index;
+	}; /* class inlining */
+	
+} /* namespace visitor */
@@ -0,0 +1,544 @@
+#pragma once
+
+/*
+ * Copyright (c) 2013 Aaron Moss
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "compiler.hpp"
+#include "left_recursion.hpp"
+#include "printer.hpp"
+#include "../ast.hpp"
+#include "../parse.hpp"
+
+namespace visitor {
+
+	/** Instructions of the interpreter's virtual machine.
+	 *  The machine has an input position, a stack of return addresses, and
+	 *  a stack of backtrack points; on failure, it returns to the most
+	 *  recent backtrack point, restoring the input position, the return
+	 *  stack, and the mute depth, or fails the match if there are none. */
+	enum opcode {
+		op_end,          /**< Succeed the match */
+		op_char,         /**< Match the character arg */
+		op_str,          /**< Match the string literal strs[arg] */
+		op_set,          /**< Match a character in sets[arg] */
+		op_span,         /**< Match any number of characters in sets[arg] */
+		op_code,         /**< Match a codepoint in the Unicode class codes[arg] */
+		op_code_span,    /**< Match any number of codepoints in codes[arg] */
+		op_any,          /**< Match any character */
+		op_call,         /**< Call the rule at address arg */
+		op_ret,          /**< Return from the current rule */
+		op_choice,       /**< Push a backtrack point to address arg */
+		op_commit,       /**< Pop the backtrack point, jump to address arg */
+		op_back_commit,  /**< Pop the backtrack point, restoring its input
+		                  *   position, and jump to address arg */
+		op_fail_twice,   /**< Pop the backtrack point, then fail */
+		op_fail,         /**< Fail */
+		op_cut,          /**< Forget input before the current position */
+		op_mute,         /**< Stop recording expectations (see 
+		                  *   parse::state::mute()) */
+		op_unmute        /**< Undo an op_mute */
+	}; /* enum opcode */
+
+	/** Outcome of running a match on the interpreter's virtual machine */
+	enum match_status {
+		match_failed,     /**< The rule did not match */
+		match_succeeded,  /**< The rule matched */
+		match_suspended   /**< The match needs input which has not been fed 
+		                   *   to the (push-mode) parser state yet */
+	}; /* enum match_status */
+
+	/** A virtual machine instruction */
+	struct instruction {
+		instruction(opcode op, parse::ind arg = 0) : op(op), arg(arg) {}
+
+		opcode op;       /**< Operation */
+		parse::ind arg;  /**< Operand */
+	}; /* struct instruction */
+
+	/** Matches input against a grammar without compiling it to C++.
+	 *  The grammar is lowered into a flat array of instructions for a
+	 *  backtracking virtual machine, which is run against a parse::state.
+	 *  Semantic actions cannot be run, and are ignored, as are rule types
+	 *  and annotations; the interpreter only determines whether (and how
+	 *  much of) the input matches. */
+	class interpreter : ast::visitor {
+	public:
+		/** Lowers a grammar into instructions.
+		 *  @throws std::invalid_argument on a reference to an undefined rule, 
+		 *  		or a left-recursive rule (which would never terminate)
+		 */
+		interpreter(ast::grammar& g) {
+			left_recursion lr(g);
+			for (auto it = g.rs.begin(); it != g.rs.end(); ++it) {
+				if ( lr.involved((*it)->name) ) throw std::invalid_argument(
+					"Left-recursive rule " + (*it)->name + " cannot be interpreted");
+			}
+			
+			//address 0 ends a successful match from a top-level rule
+			prog.push_back(instruction(op_end));
+
+			for (auto it = g.rs.begin(); it != g.rs.end(); ++it) {
+				ids.insert(std::make_pair((*it)->name, ids.size()));
+			}
+			addrs.resize(ids.size());
+			for (auto it = g.rs.begin(); it != g.rs.end(); ++it) {
+				ast::grammar_rule& r = **it;
+				addrs[ids[r.name]] = prog.size();
+				r.m->accept(this);
+				emit(op_ret);
+			}
+			if ( ! g.rs.empty() ) start = g.rs.front()->name;
+
+			//resolve rule calls, which were emitted with rule indices
+			for (auto it = prog.begin(); it != prog.end(); ++it) {
+				if ( it->op == op_call ) it->arg = addrs[it->arg];
+			}
+		}
+
+		void visit(ast::char_matcher& m) {
+			emit(op_char, (unsigned char)m.c);
+		}
+
+		void visit(ast::str_matcher& m) {
+			if ( m.s.empty() ) return;
+			if ( m.s.size() == 1 ) { emit(op_char, (unsigned char)m.s[0]); return; }
+
+			emit(op_str, strs.size());
+			strs.push_back(m.s);
+		}
+
+		void visit(ast::range_matcher& m) {
+			if ( m.utf8 ) {
+				emit(op_code, code(m));
+			} else if ( char_class_list::tabled(m) ) {
+				emit(op_set, set(m));
+			} else if ( m.neg ) {
+				emit(op_any);
+			} else if ( ! m.rs.empty() ) {
+				emit(op_char, (unsigned char)m.rs.front().to);
+			}
+		}
+
+		void visit(ast::rule_matcher& m) {
+			auto it = ids.find(m.rule);
+			if ( it == ids.end() ) {
+				throw std::invalid_argument("Undefined rule " + m.rule);
+			}
+			emit(op_call, it->second);
+		}
+
+		void visit(ast::any_matcher& m) { emit(op_any); }
+		void visit(ast::empty_matcher& m) {}
+		void visit(ast::action_matcher& m) {}
+
+		void visit(ast::opt_matcher& m) {
+			//   choice L; m; commit L; L:
+			parse::ind c = emit(op_choice);
+			m.m->accept(this);
+			parse::ind e = emit(op_commit);
+			prog[c].arg = prog[e].arg = prog.size();
+		}
+
+		void visit(ast::many_matcher& m) {
+			if ( tabled(m.m) ) {
+				emit(op_span, set(*ast::as_ptr<ast::range_matcher>(m.m)));
+				return;
+			}
+			if ( m.m->type() == ast::range_type && ast::as_ptr<ast::range_matcher>(m.m)->utf8 ) {
+				emit(op_code_span, code(*ast::as_ptr<ast::range_matcher>(m.m)));
+				return;
+			}
+
+			//   L: choice E; m; commit L; E:
+			parse::ind c = emit(op_choice);
+			m.m->accept(this);
+			emit(op_commit, c);
+			prog[c].arg = prog.size();
+		}
+
+		void visit(ast::some_matcher& m) {
+			m.m->accept(this);
+			ast::many_matcher many(m.m);
+			visit(many);
+		}
+
+		void visit(ast::seq_matcher& m) {
+			for (auto it = m.ms.begin(); it != m.ms.end(); ++it) {
+				(*it)->accept(this);
+			}
+		}
+
+		void visit(ast::alt_matcher& m) {
+			if ( m.ms.empty() ) return;
+
+			//   choice L1; m1; commit E; L1: choice L2; m2; commit E; L2: ... mn; E:
+			std::vector<parse::ind> commits;
+			for (unsigned long i = 0; i + 1 < m.ms.size(); ++i) {
+				parse::ind c = emit(op_choice);
+				m.ms[i]->accept(this);
+				commits.push_back(emit(op_commit));
+				prog[c].arg = prog.size();
+			}
+			m.ms.back()->accept(this);
+			for (auto it = commits.begin(); it != commits.end(); ++it) {
+				prog[*it].arg = prog.size();
+			}
+		}
+
+		void visit(ast::look_matcher& m) {
+			//   choice F; m; back_commit E; F: fail; E:
+			parse::ind c = emit(op_choice);
+			m.m->accept(this);
+			parse::ind b = emit(op_back_commit);
+			prog[c].arg = emit(op_fail);
+			prog[b].arg = prog.size();
+		}
+
+		void visit(ast::not_matcher& m) {
+			//   mute; choice E; m; fail_twice; E: unmute
+			//failures inside aren't errors, as in the generated code
+			emit(op_mute);
+			parse::ind c = emit(op_choice);
+			m.m->accept(this);
+			emit(op_fail_twice);
+			prog[c].arg = emit(op_unmute);
+		}
+
+		void visit(ast::capt_matcher& m) {
+			m.m->accept(this);
+		}
+
+		void visit(ast::cut_matcher& m) { emit(op_cut); }
+
+		/** A match in progress on the virtual machine: its registers and 
+		 *  stacks. A match of push-mode input (see parse::state::feed()) 
+		 *  suspends rather than reading past the input fed so far, and 
+		 *  resumes where it stopped, without matching anything again, when 
+		 *  run after more input is fed (or the input is finished). Matching 
+		 *  does not modify the interpreter, so one interpreter may be shared 
+		 *  by any number of machines, on any number of threads. */
+		class machine {
+		public:
+			/** Starts a match of the first rule of the grammar at ps.pos; 
+			 *  the interpreter and state must outlive the machine
+			 *  @throws std::invalid_argument if the grammar has no rules */
+			machine(const interpreter& vm, parse::state& ps) 
+				: vm(vm), ps(ps), pc(vm.address(vm.start)), psStart(ps.pos), calls(1, 0), 
+				  backs(), mutes(0), st(match_suspended) {}
+
+			/** Starts a match of the named rule at ps.pos, as above
+			 *  @throws std::invalid_argument if there is no such rule */
+			machine(const interpreter& vm, parse::state& ps, const std::string& rule) 
+				: vm(vm), ps(ps), pc(vm.address(rule)), psStart(ps.pos), calls(1, 0), 
+				  backs(), mutes(0), st(match_suspended) {}
+
+			/** Runs the match until it succeeds or fails, or suspends 
+			 *  waiting for more push-mode input.
+			 *  @return The status of the match; if it succeeded, ps.pos is 
+			 *          advanced past the match, and if it failed, ps.pos is 
+			 *          restored to the start of the match */
+			match_status run() {
+				if ( st != match_suspended ) return st;
+				st = vm.run(ps, *this);
+				return st;
+			}
+
+			/** The status of the match so far */
+			match_status status() const { return st; }
+
+		private:
+			friend class interpreter;
+
+			/** A point to return to on failure */
+			struct backtrack {
+				backtrack(parse::ind pc, parse::ind pos, parse::ind calls, parse::ind mutes)
+					: pc(pc), pos(pos), calls(calls), mutes(mutes) {}
+
+				parse::ind pc;     /**< Address to resume at */
+				parse::ind pos;    /**< Input position to restore */
+				parse::ind calls;  /**< Depth of the return stack to restore */
+				parse::ind mutes;  /**< Mute depth to restore */
+			}; /* struct backtrack */
+
+			const interpreter& vm;          /**< Program being run */
+			parse::state& ps;               /**< Input being matched */
+			parse::ind pc;                  /**< Address of the next instruction */
+			parse::ind psStart;             /**< Input position of the match */
+			std::vector<parse::ind> calls;  /**< Return addresses */
+			std::vector<backtrack> backs;   /**< Backtrack points */
+			parse::ind mutes;               /**< Depth of op_mute on ps */
+			match_status st;                /**< Status of the match */
+		}; /* class machine */
+
+		/** Matches the first rule of the grammar at the current position.
+		 *  @return Did the rule match? If so, ps.pos is advanced past the
+		 *          match, otherwise it is unchanged (push-mode input should 
+		 *          be matched with a machine, which can wait for input; 
+		 *          this returns false if the match needs more input) */
+		bool match(parse::state& ps) const { return match(ps, start); }
+
+		/** Matches the named rule at the current position.
+		 *  @return Did the rule match? If so, ps.pos is advanced past the
+		 *          match, otherwise it is unchanged (as above)
+		 *  @throws std::invalid_argument if there is no such rule */
+		bool match(parse::state& ps, const std::string& rule) const {
+			machine m(*this, ps, rule);
+			return m.run() == match_succeeded;
+		}
+
+		/** Gets the instructions of the lowered grammar */
+		const std::vector<instruction>& program() const { return prog; }
+
+	private:
+		/** The tables of a Unicode character class */
+		struct code_class {
+			/** Gets the members past ASCII, as a parse::code_set; it refers 
+			 *  to this class, so is invalidated with it */
+			parse::code_set set() const {
+				parse::code_set u = { rs.data(), rs.size(), name.c_str() };
+				return u;
+			}
+
+			parse::char_set ascii;               /**< ASCII members */
+			std::vector<parse::code_range> rs;   /**< Ranges of other members */
+			std::string name;                    /**< Source of the class */
+		}; /* struct code_class */
+
+		/** Gets the address of the named rule
+		 *  @throws std::invalid_argument if there is no such rule */
+		parse::ind address(const std::string& rule) const {
+			auto it = ids.find(rule);
+			if ( it == ids.end() ) throw std::invalid_argument("Undefined rule " + rule);
+			return addrs[it->second];
+		}
+
+		/** Runs the virtual machine from the registers of a match, until it 
+		 *  succeeds, fails, or needs input which has not been fed yet; a 
+		 *  suspended match is stopped before the instruction which needs 
+		 *  the input, and runs it again when resumed */
+		match_status run(parse::state& ps, machine& m) const {
+			parse::ind pc = m.pc;
+			std::vector<parse::ind>& calls = m.calls;
+			std::vector<machine::backtrack>& backs = m.backs;
+			const instruction* code = prog.data();
+
+			while ( true ) {
+				const instruction& i = code[pc];
+				switch ( i.op ) {
+				case op_end:
+					return match_succeeded;
+				case op_char:
+					if ( (unsigned char)ps[ps.pos] != i.arg ) {
+						if ( ps.waiting(ps.pos) ) goto suspend;
+						ps.expect(parse::expectation::character(char(i.arg)));
+						goto fail;
+					}
+					++ps.pos; ++pc;
+					continue;
+				case op_str: {
+					const std::string& s = strs[i.arg];
+					if ( ps.waiting(ps.pos + s.size() - 1) ) goto suspend;
+					if ( ! parse::literal(ps, s.data(), s.size()) ) goto fail;
+					++pc;
+					continue;
+				} case op_set:
+					if ( ! sets[i.arg].contains(ps[ps.pos]) ) {
+						if ( ps.waiting(ps.pos) ) goto suspend;
+						ps.expect(parse::expectation::set(sets[i.arg]));
+						goto fail;
+					}
+					++ps.pos; ++pc;
+					continue;
+				case op_span:
+					if ( ! span(ps, sets[i.arg]) ) goto suspend;
+					++pc;
+					continue;
+				case op_code: {
+					parse::code_set u = codes[i.arg].set();
+					parse::ind n = parse::code_at(ps, codes[i.arg].ascii, u);
+					if ( n == 0 ) {
+						if ( waiting_code(ps) ) goto suspend;
+						ps.expect(parse::expectation::named(u.name));
+						goto fail;
+					}
+					ps.pos += n; ++pc;
+					continue;
+				} case op_code_span:
+					if ( ! span(ps, codes[i.arg]) ) goto suspend;
+					++pc;
+					continue;
+				case op_any:
+					if ( ps[ps.pos] == '\0' ) {
+						if ( ps.waiting(ps.pos) ) goto suspend;
+						ps.expect(parse::expectation::any());
+						goto fail;
+					}
+					++ps.pos; ++pc;
+					continue;
+				case op_call:
+					calls.push_back(pc + 1);
+					pc = i.arg;
+					continue;
+				case op_ret:
+					pc = calls.back();
+					calls.pop_back();
+					continue;
+				case op_choice:
+					backs.push_back(machine::backtrack(i.arg, ps.pos, calls.size(), m.mutes));
+					++pc;
+					continue;
+				case op_commit:
+					backs.pop_back();
+					pc = i.arg;
+					continue;
+				case op_back_commit:
+					ps.pos = backs.back().pos;
+					backs.pop_back();
+					pc = i.arg;
+					continue;
+				case op_fail_twice:
+					backs.pop_back();
+					goto fail;
+				case op_fail:
+					goto fail;
+				case op_cut:
+					ps.forgetTo(ps.pos);
+					++pc;
+					continue;
+				case op_mute:
+					ps.mute(); ++m.mutes; ++pc;
+					continue;
+				case op_unmute:
+					ps.unmute(); --m.mutes; ++pc;
+					continue;
+				}
+
+			fail:
+				if ( backs.empty() ) {
+					ps.pos = m.psStart;
+					for (; m.mutes > 0; --m.mutes) ps.unmute();
+					return match_failed;
+				}
+				pc = backs.back().pc;
+				ps.pos = backs.back().pos;
+				calls.resize(backs.back().calls);
+				for (; m.mutes > backs.back().mutes; --m.mutes) ps.unmute();
+				backs.pop_back();
+			}
+
+		suspend:
+			m.pc = pc;
+			return match_suspended;
+		}
+
+		/** Matches any number of characters in s
+		 *  @return false if more push-mode input is needed to finish */
+		static bool span(parse::state& ps, const parse::char_set& s) {
+			while ( true ) {
+				parse::state::range_type r = ps.buffered(ps.pos);
+				const char* it = r.first;
+				while ( it != r.second && s.contains(*it) ) ++it;
+				ps.pos += it - r.first;
+
+				//check the following character, reading more input if needed
+				if ( ! s.contains(ps[ps.pos]) ) return ! ps.waiting(ps.pos);
+				++ps.pos;
+			}
+		}
+
+		/** Matches any number of codepoints in the Unicode class c
+		 *  @return false if more push-mode input is needed to finish */
+		static bool span(parse::state& ps, const code_class& c) {
+			parse::code_set u = c.set();
+			while ( true ) {
+				parse::state::range_type r = ps.buffered(ps.pos);
+				const char* it = r.first;
+				while ( it != r.second && c.ascii.contains(*it) ) ++it;
+				ps.pos += it - r.first;
+
+				//check the following codepoint, reading more input if needed
+				parse::ind n = parse::code_at(ps, c.ascii, u);
+				if ( n == 0 ) return ! waiting_code(ps);
+				ps.pos += n;
+			}
+		}
+
+		/** Does the codepoint at ps.pos continue past the push-mode input 
+		 *  fed so far, so that it may yet match? */
+		static bool waiting_code(parse::state& ps) {
+			parse::ind n = std::max<parse::ind>(parse::utf8_length(ps[ps.pos]), 1);
+			return ps.waiting(ps.pos + n - 1);
+		}
+
+		/** Appends an instruction to the program.
+		 *  @return The address of the instruction */
+		parse::ind emit(opcode op, parse::ind arg = 0) {
+			prog.push_back(instruction(op, arg));
+			return prog.size() - 1;
+		}
+
+		/** Gets the index of the character set for a character class */
+		parse::ind set(const ast::range_matcher& m) {
+			char_class_list::table t = char_class_list::of(m);
+			parse::char_set s = {{ t[0], t[1], t[2], t[3] }};
+			sets.push_back(s);
+			return sets.size() - 1;
+		}
+
+		/** Gets the index of the tables for a Unicode class */
+		parse::ind code(const ast::range_matcher& m) {
+			char_class_list::table t = char_class_list::of(m);
+			char_class_list::code_table rs = char_class_list::codes_of(m);
+			code_class c;
+			c.ascii = parse::char_set{{ t[0], t[1], t[2], t[3] }};
+			for (auto it = rs.begin(); it != rs.end(); ++it) {
+				c.rs.push_back(parse::code_range{ it->first, it->second });
+			}
+			c.name = printer::char_class(m);
+			codes.push_back(c);
+			return codes.size() - 1;
+		}
+
+		/** Is the matcher a character class matched with a set? */
+		static bool tabled(const ast::matcher_ptr& m) {
+			return m->type() == ast::range_type
+				&& char_class_list::tabled(*ast::as_ptr<ast::range_matcher>(m));
+		}
+
+		std::vector<instruction> prog;   /**< Instructions of the program */
+		std::vector<std::string> strs;   /**< String literals */
+		std::vector<parse::char_set> sets;  /**< Character classes */
+		std::vector<code_class> codes;   /**< Unicode character classes */
+		std::unordered_map<std::string, parse::ind> ids;  /**< Rule indices */
+		std::vector<parse::ind> addrs;   /**< Rule addresses, by index */
+		std::string start;               /**< Name of the first rule */
+	}; /* class interpreter */
+
+} /* namespace visitor */
+
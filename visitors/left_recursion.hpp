@@ -0,0 +1,232 @@
+#pragma once
+
+/*
+ * Copyright (c) 2013 Aaron Moss
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "first_set.hpp"
+#include "../ast.hpp"
+
+namespace visitor {
+
+	/** Finds the left-recursive rules of a grammar: those which may call 
+	 *  themselves, directly or through other rules, without consuming any 
+	 *  input. Such rules would recurse forever if run naively, so they are 
+	 *  matched by growing a seed result in the memo table (Warth et al., 
+	 *  "Packrat Parsers Can Support Left Recursion"). 
+	 *  
+	 *  In each group of mutually left-recursive rules, one or more "leader" 
+	 *  rules are chosen such that every left-recursive cycle passes through 
+	 *  a leader; leaders grow their seeds, while the other rules involved in 
+	 *  the cycles must not be memoized, as their results depend on the seeds 
+	 *  of the leaders. */
+	class left_recursion : ast::visitor {
+	public:
+		left_recursion() {}
+		
+		/** Finds the left-recursive rules of a grammar */
+		left_recursion(ast::grammar& g) : firsts(g) { find(g); }
+		
+		/** Finds the left-recursive rules of a grammar, given its FIRST sets */
+		left_recursion(ast::grammar& g, const first_sets& fs) : firsts(fs) { find(g); }
+		
+		void visit(ast::char_matcher& m) {}
+		void visit(ast::str_matcher& m) {}
+		void visit(ast::range_matcher& m) {}
+		
+		void visit(ast::rule_matcher& m) { calls.insert(m.rule); }
+		
+		void visit(ast::any_matcher& m) {}
+		void visit(ast::empty_matcher& m) {}
+		void visit(ast::action_matcher& m) {}
+		
+		void visit(ast::opt_matcher& m) { m.m->accept(this); }
+		void visit(ast::many_matcher& m) { m.m->accept(this); }
+		void visit(ast::some_matcher& m) { m.m->accept(this); }
+		
+		void visit(ast::seq_matcher& m) {
+			//later matchers are called at the same position only if the 
+			//earlier ones may match without consuming input
+			for (auto it = m.ms.begin(); it != m.ms.end(); ++it) {
+				(*it)->accept(this);
+				if ( ! firsts.of(**it).nullable ) break;
+			}
+		}
+		
+		void visit(ast::alt_matcher& m) {
+			for (auto it = m.ms.begin(); it != m.ms.end(); ++it) {
+				(*it)->accept(this);
+			}
+		}
+		
+		void visit(ast::look_matcher& m) { m.m->accept(this); }
+		void visit(ast::not_matcher& m) { m.m->accept(this); }
+		void visit(ast::capt_matcher& m) { m.m->accept(this); }
+		void visit(ast::cut_matcher& m) {}
+		
+		/** Is the rule part of a left-recursive cycle? */
+		bool involved(const std::string& rule) const {
+			return cyclics.count(rule) > 0;
+		}
+		
+		/** Should the rule grow a seed to match left recursion? */
+		bool leader(const std::string& rule) const {
+			return leaders.count(rule) > 0;
+		}
+		
+		/** Are there any left-recursive rules? */
+		bool any() const { return ! cyclics.empty(); }
+		
+	private:
+		/** Finds the left-recursive rules of a grammar, with firsts set */
+		void find(ast::grammar& g) {
+			//find the rules each rule may call without consuming input
+			for (auto it = g.rs.begin(); it != g.rs.end(); ++it) {
+				ast::grammar_rule& r = **it;
+				calls.clear();
+				r.m->accept(this);
+				std::vector<std::string>& cs = lefts[r.name];
+				for (auto jt = calls.begin(); jt != calls.end(); ++jt) {
+					if ( g.names.count(*jt) ) cs.push_back(*jt);
+				}
+			}
+			
+			//group the rules into strongly connected components of the 
+			//left-call graph, and choose leaders for the cyclic components
+			index = 0;
+			for (auto it = g.rs.begin(); it != g.rs.end(); ++it) {
+				if ( ! indices.count((*it)->name) ) connect((*it)->name);
+			}
+			for (auto it = g.rs.begin(); it != g.rs.end(); ++it) {
+				const std::string& name = (*it)->name;
+				if ( involved(name) ) members[comps[name]].push_back(name);
+			}
+			for (auto it = g.rs.begin(); it != g.rs.end(); ++it) {
+				const std::string& name = (*it)->name;
+				if ( ! involved(name) || leader(name) ) continue;
+				
+				//add leaders in grammar order until the component's cycles 
+				//are broken
+				unsigned long comp = comps[name];
+				const std::vector<std::string>& ms = members[comp];
+				for (auto jt = ms.begin(); jt != ms.end(); ++jt) {
+					if ( ! cyclic(comp) ) break;
+					leaders.insert(*jt);
+				}
+			}
+		}
+		
+		/** Tarjan's strongly connected components algorithm */
+		void connect(const std::string& v) {
+			indices[v] = lows[v] = index++;
+			stack.push_back(v);
+			onStack.insert(v);
+			
+			std::vector<std::string>& cs = lefts[v];
+			bool self = false;
+			for (auto it = cs.begin(); it != cs.end(); ++it) {
+				const std::string& w = *it;
+				if ( w == v ) self = true;
+				if ( ! indices.count(w) ) {
+					connect(w);
+					lows[v] = std::min(lows[v], lows[w]);
+				} else if ( onStack.count(w) ) {
+					lows[v] = std::min(lows[v], indices[w]);
+				}
+			}
+			
+			if ( lows[v] == indices[v] ) {
+				//pop the component, which is cyclic if it has more than one 
+				//rule or a rule which calls itself
+				std::vector<std::string> comp;
+				std::string w;
+				do {
+					w = stack.back();
+					stack.pop_back();
+					onStack.erase(w);
+					comps[w] = indices[v];
+					comp.push_back(w);
+				} while ( w != v );
+				
+				if ( comp.size() > 1 || self ) {
+					cyclics.insert(comp.begin(), comp.end());
+				}
+			}
+		}
+		
+		/** Does the component have a cycle which avoids all the leaders? */
+		bool cyclic(unsigned long comp) {
+			std::unordered_map<std::string, int> marks;
+			const std::vector<std::string>& ms = members[comp];
+			for (auto it = ms.begin(); it != ms.end(); ++it) {
+				if ( ! leader(*it) && cycles(*it, comp, marks) ) return true;
+			}
+			return false;
+		}
+		
+		/** Depth-first search for a cycle; marks are 1 while on the search 
+		 *  path and 2 once finished. */
+		bool cycles(const std::string& v, unsigned long comp, 
+		            std::unordered_map<std::string, int>& marks) {
+			int& mark = marks[v];
+			if ( mark == 1 ) return true;
+			if ( mark == 2 ) return false;
+			mark = 1;
+			std::vector<std::string>& cs = lefts[v];
+			for (auto it = cs.begin(); it != cs.end(); ++it) {
+				if ( comps[*it] == comp && ! leader(*it) 
+				     && cycles(*it, comp, marks) ) return true;
+			}
+			marks[v] = 2;
+			return false;
+		}
+		
+		/** FIRST sets of the grammar, used to find nullable matchers */
+		first_sets firsts;
+		/** Rules called by the current matcher without consuming input */
+		std::unordered_set<std::string> calls;
+		/** Rules each rule may call without consuming input */
+		std::unordered_map<std::string, std::vector<std::string>> lefts;
+		/** Rules in left-recursive cycles */
+		std::unordered_set<std::string> cyclics;
+		/** Rules which grow seeds */
+		std::unordered_set<std::string> leaders;
+		
+		/** Search index and low link of each visited rule */
+		std::unordered_map<std::string, unsigned long> indices, lows;
+		/** Component of each rule, named by the index of its root */
+		std::unordered_map<std::string, unsigned long> comps;
+		/** Rules of each cyclic component, in grammar order */
+		std::unordered_map<unsigned long, std::vector<std::string>> members;
+		/** Rules on the Tarjan stack */
+		std::vector<std::string> stack;
+		std::unordered_set<std::string> onStack;
+		/** Next search index */
+		unsigned long index;
+	}; /* class left_recursion */
+	
+} /* namespace visitor */
+
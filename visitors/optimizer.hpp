@@ -0,0 +1,467 @@
+#pragma once
+
+/*
+ * Copyright (c) 2013 Aaron Moss
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../ast.hpp"
+#include "first_set.hpp"
+
+namespace visitor {
+
+	/** Optimizes a normalized Egg AST, so that generated parsers backtrack 
+	 *  less. Nested sequences and alternations are flattened, adjacent 
+	 *  literals in a sequence are merged into a string, the ranges of a 
+	 *  character class are merged, adjacent single-character alternatives 
+	 *  are folded into a class, alternatives which can never match because 
+	 *  an earlier alternative always matches first are removed (with a 
+	 *  warning), and common literal prefixes of adjacent alternatives are 
+	 *  factored out. Alternations made only of literals are not factored, 
+	 *  and sequences and alternatives beginning actions which refer to 
+	 *  `psStart` are not restructured, as that would move their start. 
+	 *  Matchers are rewritten in place where possible; any new matchers are 
+	 *  allocated from the current AST arena. */
+	class optimizer : ast::visitor {
+	public:
+		optimizer(std::ostream& err = std::cerr) : err(err) {}
+
+		void visit(ast::char_matcher& m) { rVal = &m; }
+
+		void visit(ast::str_matcher& m) {
+			if ( m.s.size() == 1 ) rVal = ast::make_ptr<ast::char_matcher>(m.s[0]);
+			else rVal = &m;
+		}
+
+		void visit(ast::range_matcher& m) {
+			merge_ranges(m);
+			//a Unicode class of one codepoint matches its UTF-8 encoding
+			if ( m.utf8 && ! m.neg && m.rs.size() == 1 && m.rs.front().single() ) {
+				rVal = make_literal(strings::utf8(m.rs.front().from));
+				return;
+			}
+			rVal = &m;
+		}
+
+		void visit(ast::rule_matcher& m) { rVal = &m; }
+
+		void visit(ast::any_matcher& m) { rVal = &m; }
+		
+		void visit(ast::empty_matcher& m) { rVal = &m; }
+
+		void visit(ast::action_matcher& m) { rVal = &m; }
+		
+		void visit(ast::opt_matcher& m) {
+			m.m->accept(this);
+			m.m = rVal;
+			rVal = &m;
+		}
+
+		void visit(ast::many_matcher& m) {
+			m.m->accept(this);
+			m.m = rVal;
+			rVal = &m;
+		}
+
+		void visit(ast::some_matcher& m) {
+			m.m->accept(this);
+			m.m = rVal;
+			rVal = &m;
+		}
+
+		void visit(ast::seq_matcher& m) {
+			//flatten nested sequences (unless that moves their psStart), 
+			//dropping empty matchers
+			std::vector<ast::matcher_ptr> ms;
+			for (auto it = m.ms.begin(); it != m.ms.end(); ++it) {
+				(*it)->accept(this);
+				if ( rVal->type() == ast::seq_type 
+				     && ! refers_start(*ast::as_ptr<ast::seq_matcher>(rVal)) ) {
+					ast::seq_matcher_ptr s = ast::as_ptr<ast::seq_matcher>(rVal);
+					ms.insert(ms.end(), s->ms.begin(), s->ms.end());
+				} else if ( rVal->type() != ast::empty_type ) {
+					ms.push_back(rVal);
+				}
+			}
+
+			//merge adjacent literals into strings
+			m.ms.clear();
+			std::string s, t;
+			for (auto it = ms.begin(); it != ms.end(); ++it) {
+				if ( ! m.ms.empty() && literal(*it, s) && literal(m.ms.back(), t) ) {
+					m.ms.back() = ast::make_ptr<ast::str_matcher>(t + s);
+				} else {
+					m.ms.push_back(*it);
+				}
+			}
+
+			switch ( m.ms.size() ) {
+			case 0:  rVal = ast::make_ptr<ast::empty_matcher>(); break;
+			case 1:  rVal = m.ms.front(); break;
+			default: rVal = &m; break;
+			}
+		}
+		
+		void visit(ast::alt_matcher& m) {
+			//flatten nested alternations
+			std::vector<ast::matcher_ptr> ms;
+			for (auto it = m.ms.begin(); it != m.ms.end(); ++it) {
+				(*it)->accept(this);
+				if ( rVal->type() == ast::alt_type ) {
+					ast::alt_matcher_ptr a = ast::as_ptr<ast::alt_matcher>(rVal);
+					ms.insert(ms.end(), a->ms.begin(), a->ms.end());
+				} else {
+					ms.push_back(rVal);
+				}
+			}
+
+			//remove alternatives which can't match, as an earlier one always 
+			//matches whenever they would
+			std::vector<ast::matcher_ptr> live;
+			std::vector<unsigned long> index;
+			for (unsigned long j = 0; j < ms.size(); ++j) {
+				unsigned long i = 0;
+				while ( i < live.size() && ! covers(*live[i], *ms[j]) ) ++i;
+				if ( i < live.size() ) {
+					err << "Warning: alternative " << (j+1) << " of a choice in rule " 
+					    << rule << " can never match, as alternative " << (index[i]+1) 
+					    << " always matches first" << std::endl;
+				} else {
+					live.push_back(ms[j]);
+					index.push_back(j);
+				}
+			}
+
+			//fold adjacent single-character alternatives into a class
+			ms.clear();
+			for (auto it = live.begin(); it != live.end(); ++it) {
+				if ( ! ms.empty() && single(**it) && single(*ms.back()) ) {
+					ast::range_matcher_ptr r = ast::make_ptr<ast::range_matcher>();
+					add_ranges(*r, *ms.back());
+					add_ranges(*r, **it);
+					merge_ranges(*r);
+					ms.back() = r;
+				} else {
+					ms.push_back(*it);
+				}
+			}
+
+			//factor out common literal prefixes of adjacent alternatives
+			m.ms.clear();
+			for (unsigned long i = 0; i < ms.size(); ) {
+				std::string p = factorable(*ms[i]) ? lead(*ms[i]) : std::string();
+				unsigned long j = i + 1;
+				bool literals = rest_empty(*ms[i], p);
+				while ( ! p.empty() && j < ms.size() && factorable(*ms[j]) ) {
+					std::string q = lead(*ms[j]);
+					unsigned long n = 0;
+					while ( n < p.size() && n < q.size() && p[n] == q[n] ) ++n;
+					if ( n == 0 ) break;
+					p.resize(n);
+					literals = literals && rest_empty(*ms[j], q);
+					++j;
+				}
+
+				if ( j - i < 2 || literals ) {
+					m.ms.insert(m.ms.end(), ms.begin() + i, ms.begin() + j);
+				} else {
+					ast::alt_matcher_ptr rests = ast::make_ptr<ast::alt_matcher>();
+					for (unsigned long k = i; k < j; ++k) *rests += rest(ms[k], p.size());
+					ast::seq_matcher_ptr f = ast::make_ptr<ast::seq_matcher>();
+					*f += make_literal(p);
+					*f += rests;
+					f->accept(this);
+					m.ms.push_back(rVal);
+				}
+				i = j;
+			}
+
+			switch ( m.ms.size() ) {
+			case 0:  rVal = ast::make_ptr<ast::empty_matcher>(); break;
+			case 1:  rVal = m.ms.front(); break;
+			default: rVal = &m; break;
+			}
+		}
+
+		void visit(ast::look_matcher& m) {
+			m.m->accept(this);
+			m.m = rVal;
+			rVal = &m;
+		}
+
+		void visit(ast::not_matcher& m) {
+			m.m->accept(this);
+			m.m = rVal;
+			rVal = &m;
+		}
+
+		void visit(ast::capt_matcher& m) {
+			m.m->accept(this);
+			m.m = rVal;
+			rVal = &m;
+		}
+
+		void visit(ast::cut_matcher& m) { rVal = &m; }
+
+		ast::grammar_rule& optimize(ast::grammar_rule& r) {
+			rule = r.name;
+			r.m->accept(this);
+			r.m = rVal;
+			return r;
+		}
+
+		ast::grammar& optimize(ast::grammar& g) {
+			for (auto it = g.rs.begin(); it != g.rs.end(); ++it) {
+				optimize(**it);
+			}
+			return g;
+		}
+	
+	private:
+		/** Gets the string matched by a literal matcher into s.
+		 *  @return is m a character or string literal? */
+		static bool literal(ast::matcher_ptr m, std::string& s) {
+			switch ( m->type() ) {
+			case ast::char_type: s = std::string(1, ast::as_ptr<ast::char_matcher>(m)->c); return true;
+			case ast::str_type:  s = ast::as_ptr<ast::str_matcher>(m)->s; return true;
+			default: return false;
+			}
+		}
+
+		static ast::matcher_ptr make_literal(const std::string& s) {
+			if ( s.size() == 1 ) return ast::make_ptr<ast::char_matcher>(s[0]);
+			return ast::make_ptr<ast::str_matcher>(s);
+		}
+
+		/** Does the matcher contain an action referring to the enclosing 
+		 *  sequence's psStart? Nested sequences and lookaheads bind their own. */
+		static bool uses_start(ast::matcher_ptr m) {
+			switch ( m->type() ) {
+			case ast::action_type:
+				return ast::as_ptr<ast::action_matcher>(m)->a.find("psStart") 
+				       != std::string::npos;
+			case ast::opt_type:  return uses_start(ast::as_ptr<ast::opt_matcher>(m)->m);
+			case ast::many_type: return uses_start(ast::as_ptr<ast::many_matcher>(m)->m);
+			case ast::some_type: return uses_start(ast::as_ptr<ast::some_matcher>(m)->m);
+			case ast::capt_type: return uses_start(ast::as_ptr<ast::capt_matcher>(m)->m);
+			case ast::alt_type: {
+				ast::alt_matcher_ptr a = ast::as_ptr<ast::alt_matcher>(m);
+				for (auto it = a->ms.begin(); it != a->ms.end(); ++it) {
+					if ( uses_start(*it) ) return true;
+				}
+				return false;
+			}
+			default: return false;
+			}
+		}
+
+		/** Does the sequence contain an action referring to its psStart? */
+		static bool refers_start(ast::seq_matcher& m) {
+			for (auto it = m.ms.begin(); it != m.ms.end(); ++it) {
+				if ( uses_start(*it) ) return true;
+			}
+			return false;
+		}
+
+		/** Can the alternative be split after its leading literals? */
+		static bool factorable(ast::matcher& m) {
+			return m.type() != ast::seq_type || ! refers_start(static_cast<ast::seq_matcher&>(m));
+		}
+
+		/** Gets the literal string an alternative begins with */
+		static std::string lead(ast::matcher& m) {
+			std::string r, s;
+			if ( literal(&m, s) ) return s;
+			if ( m.type() != ast::seq_type ) return r;
+			ast::seq_matcher& q = static_cast<ast::seq_matcher&>(m);
+			for (auto it = q.ms.begin(); it != q.ms.end() && literal(*it, s); ++it) r += s;
+			return r;
+		}
+
+		/** Is the alternative all the literal string s? */
+		static bool rest_empty(ast::matcher& m, const std::string& s) {
+			std::string t;
+			return literal(&m, t) && t == s;
+		}
+
+		/** Gets the remainder of an alternative after its first n characters, 
+		 *  which are matched by its leading literals */
+		static ast::matcher_ptr rest(ast::matcher_ptr m, unsigned long n) {
+			std::vector<ast::matcher_ptr> ms;
+			if ( m->type() == ast::seq_type ) ms = ast::as_ptr<ast::seq_matcher>(m)->ms;
+			else ms.push_back(m);
+
+			ast::seq_matcher_ptr r = ast::make_ptr<ast::seq_matcher>();
+			std::string s;
+			auto it = ms.begin();
+			for (; n > 0; ++it) {
+				literal(*it, s);
+				if ( s.size() > n ) *r += make_literal(s.substr(n));
+				n -= std::min<unsigned long>(n, s.size());
+			}
+			for (; it != ms.end(); ++it) *r += *it;
+
+			switch ( r->ms.size() ) {
+			case 0:  return ast::make_ptr<ast::empty_matcher>();
+			case 1:  return r->ms.front();
+			default: return r;
+			}
+		}
+
+		/** Does the matcher always match a single character from a class? */
+		static bool single(ast::matcher& m) {
+			switch ( m.type() ) {
+			case ast::char_type:  return true;
+			case ast::range_type: {
+				ast::range_matcher& r = static_cast<ast::range_matcher&>(m);
+				return ! r.neg && ! r.rs.empty();
+			} default: return false;
+			}
+		}
+
+		/** Adds the characters matched by a single-character matcher to r */
+		static void add_ranges(ast::range_matcher& r, ast::matcher& m) {
+			if ( m.type() == ast::char_type ) {
+				r += ast::char_range(static_cast<ast::char_matcher&>(m).c);
+			} else {
+				ast::range_matcher& o = static_cast<ast::range_matcher&>(m);
+				r.rs.insert(r.rs.end(), o.rs.begin(), o.rs.end());
+				r.utf8 |= o.utf8;
+			}
+		}
+
+		/** Sorts the ranges of a character class, merging those which overlap 
+		 *  or are adjacent */
+		static void merge_ranges(ast::range_matcher& m) {
+			if ( m.rs.size() < 2 ) return;
+			std::vector<ast::char_range> rs(m.rs);
+			std::sort(rs.begin(), rs.end(), 
+				[](const ast::char_range& a, const ast::char_range& b) { return a.from < b.from; });
+			m.rs.clear();
+			for (auto it = rs.begin(); it != rs.end(); ++it) {
+				if ( ! m.rs.empty() && int(it->from) <= int(m.rs.back().to) + 1 ) {
+					m.rs.back().to = std::max(m.rs.back().to, it->to);
+				} else {
+					m.rs.push_back(*it);
+				}
+			}
+		}
+
+		/** Can the matcher never fail? */
+		static bool never_fails(ast::matcher& m) {
+			switch ( m.type() ) {
+			case ast::empty_type:
+			case ast::action_type:
+			case ast::opt_type:
+			case ast::many_type:
+			case ast::cut_type:
+				return true;
+			case ast::str_type:
+				return static_cast<ast::str_matcher&>(m).s.empty();
+			case ast::range_type: {
+				ast::range_matcher& r = static_cast<ast::range_matcher&>(m);
+				return ! r.neg && r.rs.empty();
+			} case ast::capt_type:
+				return never_fails(*static_cast<ast::capt_matcher&>(m).m);
+			case ast::seq_type: {
+				ast::seq_matcher& s = static_cast<ast::seq_matcher&>(m);
+				for (auto it = s.ms.begin(); it != s.ms.end(); ++it) {
+					if ( ! never_fails(**it) ) return false;
+				}
+				return true;
+			} case ast::alt_type: {
+				ast::alt_matcher& a = static_cast<ast::alt_matcher&>(m);
+				for (auto it = a.ms.begin(); it != a.ms.end(); ++it) {
+					if ( never_fails(**it) ) return true;
+				}
+				return a.ms.empty();
+			} default:
+				return false;
+			}
+		}
+
+		/** Gets the matchers of a sequence, or the matcher itself otherwise */
+		static std::vector<ast::matcher_ptr> elements(ast::matcher& m) {
+			if ( m.type() == ast::seq_type ) return static_cast<ast::seq_matcher&>(m).ms;
+			return std::vector<ast::matcher_ptr>(1, &m);
+		}
+
+		/** Is the matcher a terminal which matches one character? */
+		static bool terminal(ast::matcher& m) {
+			switch ( m.type() ) {
+			case ast::char_type: case ast::any_type: return true;
+			case ast::range_type: {
+				//Unicode classes may match several characters
+				ast::range_matcher& r = static_cast<ast::range_matcher&>(m);
+				return ( ! r.rs.empty() || r.neg ) && ! r.utf8;
+			}
+			default: return false;
+			}
+		}
+
+		/** Does one alternative always match when a later one would, so that 
+		 *  the later one is never matched? The earlier alternative must begin 
+		 *  with literals or a character class, followed by matchers which 
+		 *  can't fail, and the later must then fail on its first terminal 
+		 *  (so without running any actions) unless the earlier matches. */
+		bool covers(ast::matcher& a, ast::matcher& b) {
+			if ( never_fails(a) ) return true;
+
+			//split the earlier alternative into its head and (infallible) tail
+			std::vector<ast::matcher_ptr> as = elements(a);
+			std::string s, t;
+			unsigned long k = 0;
+			while ( k < as.size() && literal(as[k], t) ) { s += t; ++k; }
+			if ( s.empty() ) {
+				if ( ! terminal(*as[0]) ) return false;
+				k = 1;
+			}
+			for (unsigned long i = k; i < as.size(); ++i) {
+				if ( ! never_fails(*as[i]) ) return false;
+			}
+
+			//literals match any input beginning with a longer literal
+			if ( s.size() > 0 ) {
+				t = lead(b);
+				return t.size() >= s.size() && t.compare(0, s.size(), s) == 0;
+			}
+
+			//a character class matches any input beginning with a terminal 
+			//matching a subset of it
+			std::vector<ast::matcher_ptr> bs = elements(b);
+			if ( bs.empty() ) return false;
+			if ( bs[0]->type() != ast::str_type && ! terminal(*bs[0]) ) return false;
+			first_set fa = firsts.of(*as[0]), fb = firsts.of(*bs[0]);
+			if ( fa.nullable || fb.nullable ) return false;
+			return ( fb.chars & ~fa.chars ).none();
+		}
+
+		std::ostream& err;		/**< Stream for warnings */
+		std::string rule;		/**< Name of the rule being optimized */
+		first_sets firsts;		/**< FIRST sets of terminals */
+		ast::matcher_ptr rVal;	/**< The matcher to return for the current visit */
+	}; /* class optimizer */
+	
+} /* namespace visitor */
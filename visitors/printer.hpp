@@ -45,17 +45,7 @@ namespace visitor {
 		}
 
 		void visit(ast::range_matcher& m) {
-			out << "[";
-
-			for (auto iter = m.rs.begin(); iter != m.rs.end(); ++iter) {
-				ast::char_range& r = *iter;
-				out << strings::escape(r.from);
-				if ( r.from != r.to ) {
-					out << "-" << strings::escape(r.to);
-				}
-			}
-			
-			out << "]";
+			out << char_class(m);
 		}
 		
 		void visit(ast::rule_matcher& m) {
@@ -100,7 +90,7 @@ namespace visitor {
 				auto iter = m.ms.begin();
 				(*iter)->accept(this);
 				while ( ++iter != m.ms.end() ) {
-					out << std::endl << indent;
+					out << '\n' << indent;
 					(*iter)->accept(this);
 				}
 				
@@ -140,34 +130,60 @@ namespace visitor {
 			out << " >";
 		}
 
+		void visit(ast::cut_matcher& m) {
+			out << "^";
+		}
+
 		void print(ast::grammar_rule& r) {
+			for (auto iter = r.annotations.begin(); iter != r.annotations.end(); ++iter) {
+				out << "%" << *iter << " ";
+			}
 			out << r.name;
 			if ( ! r.type.empty() ) {
 				out << " : " << r.type;
 			}
 			out << " = ";
 			r.m->accept(this);
-			out << std::endl;
+			out << '\n';
 		}
 
 		void print(ast::grammar& g) {
 			if ( ! g.pre.empty() ) {
-				out << "{%" << g.pre << "%}" << std::endl;
+				out << "{%" << g.pre << "%}" << '\n';
 			}
 
-			out << std::endl;
+			out << '\n';
 			for (auto iter = g.rs.begin(); iter != g.rs.end(); ++iter) {
 				ast::grammar_rule_ptr& r = *iter;
 				print(*r);
 			}
-			out << std::endl;
+			out << '\n';
 
 			if ( ! g.post.empty() ) {
-				out << "{%" << g.post << "%}" <<std::endl << std::endl;
+				out << "{%" << g.post << "%}" << '\n' << '\n';
 			}
 		}
 		
+		/** Gets the source of a character class. Characters past ASCII are 
+		 *  written as Unicode escapes; a Unicode class without any is marked 
+		 *  by also writing its first character as one. */
+		static std::string char_class(const ast::range_matcher& m) {
+			bool mark = m.utf8;
+			for (auto it = m.rs.begin(); it != m.rs.end(); ++it) {
+				if ( it->to > 0x7f ) mark = false;
+			}
+
+			std::string s = m.neg ? "[^" : "[";
+			for (auto it = m.rs.begin(); it != m.rs.end(); ++it) {
+				s += strings::escape(it->from, mark);
+				if ( it->from != it->to ) s += "-" + strings::escape(it->to);
+				mark = false;
+			}
+			return s + "]";
+		}
+
 	private:
+
 		std::ostream& out;	/**< output stream */
 		int tabs;			/**< current number of tab stops */
 	};